@@ -0,0 +1,74 @@
+// arena.c
+#include "mas.h"
+
+// Bump allocator for data that is released all at once, such as the AST of
+// a program. Memory comes from 64 KB blocks; a request too big to share a
+// block gets one of its own. Nothing is freed individually.
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 8
+
+struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+};
+
+#define BLOCK_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static ArenaBlock* arena_new_block(size_t size) {
+    ArenaBlock* block = malloc(BLOCK_HEADER_SIZE + size);
+    if (!block) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock* block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        if (size > ARENA_BLOCK_SIZE / 4) {
+            // Keep the current block open for the small requests after this
+            ArenaBlock* large = arena_new_block(size);
+            large->used = size;
+            if (block) {
+                large->next = block->next;
+                block->next = large;
+            } else {
+                large->next = NULL;
+                arena->blocks = large;
+            }
+            return (char*)large + BLOCK_HEADER_SIZE;
+        }
+        block = arena_new_block(ARENA_BLOCK_SIZE);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    void* memory = (char*)block + BLOCK_HEADER_SIZE + block->used;
+    block->used += size;
+    return memory;
+}
+
+// Hands every block of 'from' over to 'to', leaving 'from' empty
+void arena_move(Arena* to, Arena* from) {
+    ArenaBlock* last = from->blocks;
+    if (!last) return;
+    while (last->next) last = last->next;
+    last->next = to->blocks;
+    to->blocks = from->blocks;
+    from->blocks = NULL;
+}
+
+void arena_free(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
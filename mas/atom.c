@@ -0,0 +1,119 @@
+// atom.c
+#include "mas.h"
+
+// Identifiers are interned: every distinct name is stored once, and two
+// atoms are the same name exactly when they are the same pointer. The table
+// is open-addressed with linear probing and lives as long as the program.
+
+typedef struct {
+    Atom* slots;
+    uint32_t* hashes;
+    int count;
+    int capacity;      // a power of two, kept at most half full
+} AtomTable;
+
+static AtomTable atoms;
+
+static uint32_t hash_name(const char* name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void grow_atoms() {
+    int capacity = atoms.capacity ? atoms.capacity * 2 : 256;
+    Atom* slots = calloc(capacity, sizeof(Atom));
+    uint32_t* hashes = malloc(sizeof(uint32_t) * capacity);
+    uint32_t mask = (uint32_t)capacity - 1;
+    for (int i = 0; i < atoms.capacity; i++) {
+        if (!atoms.slots[i]) continue;
+        uint32_t j = atoms.hashes[i] & mask;
+        while (slots[j]) j = (j + 1) & mask;
+        slots[j] = atoms.slots[i];
+        hashes[j] = atoms.hashes[i];
+    }
+    free(atoms.slots);
+    free(atoms.hashes);
+    atoms.slots = slots;
+    atoms.hashes = hashes;
+    atoms.capacity = capacity;
+}
+
+Atom atom_intern_length(const char* name, size_t length) {
+    if ((atoms.count + 1) * 2 > atoms.capacity) grow_atoms();
+
+    uint32_t hash = hash_name(name, length);
+    uint32_t mask = (uint32_t)atoms.capacity - 1;
+    uint32_t i = hash & mask;
+    for (; atoms.slots[i]; i = (i + 1) & mask) {
+        if (atoms.hashes[i] == hash && strncmp(atoms.slots[i], name, length) == 0
+                && atoms.slots[i][length] == '\0') {
+            return atoms.slots[i];
+        }
+    }
+
+    char* copy = malloc(length + 1);
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    atoms.slots[i] = copy;
+    atoms.hashes[i] = hash;
+    atoms.count++;
+    return copy;
+}
+
+Atom atom_intern(const char* name) {
+    return atom_intern_length(name, strlen(name));
+}
+
+// Atom maps are keyed by the atom pointer itself
+static uint32_t hash_atom(Atom atom) {
+    uint64_t bits = (uint64_t)(uintptr_t)atom;
+    bits ^= bits >> 29;
+    bits *= 0xbf58476d1ce4e5b9ULL;
+    return (uint32_t)(bits >> 32);
+}
+
+int atom_map_get(const AtomMap* map, Atom key) {
+    if (map->count == 0) return -1;
+    uint32_t mask = (uint32_t)map->capacity - 1;
+    for (uint32_t i = hash_atom(key) & mask; map->keys[i]; i = (i + 1) & mask) {
+        if (map->keys[i] == key) return map->values[i];
+    }
+    return -1;
+}
+
+static void atom_map_insert(AtomMap* map, Atom key, int value) {
+    uint32_t mask = (uint32_t)map->capacity - 1;
+    uint32_t i = hash_atom(key) & mask;
+    while (map->keys[i] && map->keys[i] != key) i = (i + 1) & mask;
+    if (!map->keys[i]) {
+        map->keys[i] = key;
+        map->count++;
+    }
+    map->values[i] = value;
+}
+
+void atom_map_set(AtomMap* map, Atom key, int value) {
+    if ((map->count + 1) * 2 > map->capacity) {
+        AtomMap old = *map;
+        map->capacity = old.capacity ? old.capacity * 2 : 16;
+        map->keys = calloc(map->capacity, sizeof(Atom));
+        map->values = malloc(sizeof(int) * map->capacity);
+        map->count = 0;
+        for (int i = 0; i < old.capacity; i++) {
+            if (old.keys[i]) atom_map_insert(map, old.keys[i], old.values[i]);
+        }
+        free(old.keys);
+        free(old.values);
+    }
+    atom_map_insert(map, key, value);
+}
+
+void atom_map_free(AtomMap* map) {
+    free(map->keys);
+    free(map->values);
+    *map = (AtomMap){0};
+}
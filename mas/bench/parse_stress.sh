@@ -0,0 +1,67 @@
+#!/bin/sh
+# Parser stress benchmark. Generates a script with STATEMENTS top-level
+# statements (1,000,000 by default) that also holds a long list literal, a
+# function with many parameters and a large block body, then runs it and
+# fails if mas takes longer than LIMIT seconds (default 60) or prints the
+# wrong result.
+#
+#   sh bench/parse_stress.sh [path/to/mas] [mas options...]
+
+MAS=${1:-./mas}
+[ $# -gt 0 ] && shift
+STATEMENTS=${STATEMENTS:-1000000}
+LIMIT=${LIMIT:-60}
+SCRIPT=${TMPDIR:-/tmp}/mas_parse_stress_$$.mas
+trap 'rm -f "$SCRIPT"' EXIT
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    printf "def add(p0"
+    for (i = 1; i < 40; i++) printf ", p%d", i
+    printf "):\n    give p0"
+    for (i = 1; i < 40; i++) printf " + p%d", i
+    print "\nend"
+
+    printf "table = [0"
+    for (i = 1; i < 10000; i++) printf ", %d", i
+    print "]"
+
+    print "if true:"
+    for (i = 0; i < 10000; i++) print "    total = total + 1"
+    print "end"
+
+    # add(...) with 40 arguments of 1 adds 40; the other statements add 1
+    for (i = 3; i < n - 1; i++) {
+        if (i % 1000 == 0) {
+            printf "total = total + add(1"
+            for (j = 1; j < 40; j++) printf ", 1"
+            print ") - 39"
+        } else if (i % 2 == 0) {
+            print "total = total + 1"
+        } else {
+            print "row = [total, total + 1, " i "]"
+        }
+    }
+    print "print total + len(table)"
+}' > "$SCRIPT"
+
+# Every even i adds one, as do the block statements and the table length
+EXPECTED=$(awk -v n="$STATEMENTS" 'BEGIN {
+    total = 10000 + 10000
+    for (i = 3; i < n - 1; i++) if (i % 2 == 0) total++
+    print total
+}')
+
+START=$(date +%s)
+OUTPUT=$(timeout "$LIMIT" "$MAS" "$@" "$SCRIPT")
+STATUS=$?
+ELAPSED=$(( $(date +%s) - START ))
+
+if [ $STATUS -eq 124 ]; then
+    echo "parse_stress: FAILED, $STATEMENTS statements took more than $LIMIT s"
+    exit 1
+fi
+if [ $STATUS -ne 0 ] || [ "$OUTPUT" != "$EXPECTED" ]; then
+    echo "parse_stress: FAILED, expected $EXPECTED, got '$OUTPUT' (exit status $STATUS)"
+    exit 1
+fi
+echo "parse_stress: $STATEMENTS statements in ${ELAPSED} s"
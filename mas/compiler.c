@@ -0,0 +1,410 @@
+// compiler.c
+#include "mas.h"
+
+// Jumps out of a loop body that still need their target filled in
+typedef struct {
+    int* patches;
+    int count;
+    int capacity;
+} PatchList;
+
+typedef struct Loop {
+    struct Loop* enclosing;
+    int continue_target;     // where 'next' jumps to
+    PatchList breaks;        // 'stop' jumps, patched to the loop exit
+} Loop;
+
+typedef struct {
+    Chunk* chunk;
+    Loop* loop;
+    bool in_function;
+    int depth;               // current operand stack depth
+    int line;                // source line of the node being compiled
+    AtomMap names;           // name -> index of its constant in the chunk
+} Compiler;
+
+static void compile_node(Compiler* c, ASTNode* node);
+
+static Chunk* new_chunk() {
+    Chunk* chunk = calloc(1, sizeof(Chunk));
+    return chunk;
+}
+
+static bool is_name_object(MASObject* obj);
+
+// Releases a top-level chunk once it has run. The functions it defined
+// live on in the VM. Its string literals are freed too with --stream, which
+// only ever hands out copies of them (OP_STRING); otherwise values that
+// outlive the chunk may still point to them.
+void free_chunk(Chunk* chunk) {
+    if (chunk->jit) jit_free(chunk->jit);
+    for (int i = 0; options.stream && i < chunk->constant_count; i++) {
+        Value k = chunk->constants[i];
+        if (IS_STRING(k) && !is_name_object(AS_OBJ(k))) {
+            free(AS_OBJ(k)->data.string);
+            free(AS_OBJ(k));
+        }
+    }
+    free(chunk->code);
+    free(chunk->lines);
+    free(chunk->constants);
+    free(chunk->functions);
+    free(chunk);
+}
+
+static void emit(Compiler* c, int word) {
+    Chunk* chunk = c->chunk;
+    if (chunk->count >= chunk->capacity) {
+        chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+        chunk->code = realloc(chunk->code, sizeof(int) * chunk->capacity);
+        chunk->lines = realloc(chunk->lines, sizeof(int) * chunk->capacity);
+    }
+    chunk->code[chunk->count] = word;
+    chunk->lines[chunk->count] = c->line;
+    chunk->count++;
+}
+
+// Emit an opcode and track its effect on the operand stack
+static void emit_op(Compiler* c, OpCode op, int stack_effect) {
+    emit(c, op);
+    c->depth += stack_effect;
+    if (c->depth > c->chunk->max_stack) {
+        c->chunk->max_stack = c->depth;
+    }
+}
+
+// Emit a forward jump and return the position of its target operand
+static int emit_jump(Compiler* c, OpCode op, int stack_effect) {
+    emit_op(c, op, stack_effect);
+    emit(c, -1);
+    return c->chunk->count - 1;
+}
+
+static void patch_jump(Compiler* c, int operand) {
+    c->chunk->code[operand] = c->chunk->count;
+}
+
+static int add_constant(Compiler* c, Value value) {
+    Chunk* chunk = c->chunk;
+    if (chunk->constant_count >= chunk->constant_capacity) {
+        chunk->constant_capacity = chunk->constant_capacity ? chunk->constant_capacity * 2 : 16;
+        chunk->constants = realloc(chunk->constants, sizeof(Value) * chunk->constant_capacity);
+    }
+    chunk->constants[chunk->constant_count] = value;
+    return chunk->constant_count++;
+}
+
+// Names are stored as string constants whose characters are the atom
+// itself, so the VM can compare them by pointer. There is one such object
+// per name, shared by every chunk.
+static AtomMap name_indices;
+static MASObject** name_objects = NULL;
+static int name_object_count = 0;
+static int name_object_capacity = 0;
+
+static MASObject* name_object(Atom name) {
+    int index = atom_map_get(&name_indices, name);
+    if (index >= 0) return name_objects[index];
+
+    if (name_object_count >= name_object_capacity) {
+        name_object_capacity = name_object_capacity ? name_object_capacity * 2 : 64;
+        name_objects = realloc(name_objects, sizeof(MASObject*) * name_object_capacity);
+    }
+    MASObject* obj = calloc(1, sizeof(MASObject));
+    obj->type = AST_STRING;
+    obj->data.string = (char*)name;
+    atom_map_set(&name_indices, name, name_object_count);
+    name_objects[name_object_count++] = obj;
+    return obj;
+}
+
+static bool is_name_object(MASObject* obj) {
+    int index = atom_map_get(&name_indices, obj->data.string);
+    return index >= 0 && name_objects[index] == obj;
+}
+
+// Reuse the chunk's constant for the name if it has one
+static int name_constant(Compiler* c, Atom name) {
+    int index = atom_map_get(&c->names, name);
+    if (index < 0) {
+        index = add_constant(c, OBJ_VAL(name_object(name)));
+        atom_map_set(&c->names, name, index);
+    }
+    return index;
+}
+
+static void emit_get(Compiler* c, int slot, bool global) {
+    emit_op(c, global ? OP_GET_GLOBAL : OP_GET_LOCAL, 1);
+    emit(c, slot);
+}
+
+static void add_patch(PatchList* list, int operand) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->patches = realloc(list->patches, sizeof(int) * list->capacity);
+    }
+    list->patches[list->count++] = operand;
+}
+
+static void compile_block(Compiler* c, ASTNode** body, int count) {
+    for (int i = 0; i < count; i++) {
+        compile_node(c, body[i]);
+    }
+}
+
+// Compile a loop body; 'stop' jumps are patched by the caller via loop->breaks
+static void compile_loop_body(Compiler* c, Loop* loop, ASTNode** body, int count) {
+    loop->enclosing = c->loop;
+    c->loop = loop;
+    compile_block(c, body, count);
+    c->loop = loop->enclosing;
+}
+
+static void patch_breaks(Compiler* c, Loop* loop) {
+    for (int i = 0; i < loop->breaks.count; i++) {
+        patch_jump(c, loop->breaks.patches[i]);
+    }
+    free(loop->breaks.patches);
+}
+
+static FunctionProto* compile_function(ASTNode* node) {
+    FunctionProto* proto = calloc(1, sizeof(FunctionProto));
+    proto->name = node->data.funcdef.name;
+    proto->params = node->data.funcdef.params;
+    proto->param_count = node->data.funcdef.param_count;
+    proto->local_count = node->data.funcdef.local_count;
+
+    Compiler c = {0};
+    c.chunk = &proto->chunk;
+    c.in_function = true;
+    c.line = node->line;
+    compile_block(&c, node->data.funcdef.body, node->data.funcdef.body_count);
+    // Falling off the end of a function returns null
+    emit_op(&c, OP_NULL, 1);
+    emit_op(&c, OP_RETURN, -1);
+    atom_map_free(&c.names);
+    return proto;
+}
+
+static void compile_call(Compiler* c, ASTNode* node) {
+    for (int i = 0; i < node->data.call.arg_count; i++) {
+        compile_node(c, node->data.call.args[i]);
+    }
+    int argc = node->data.call.arg_count;
+    int builtin = node->data.call.builtin;
+    if (builtin >= 0) {
+        emit_op(c, OP_CALL_BUILTIN, 1 - argc);
+        emit(c, builtin);
+    } else {
+        emit_op(c, node->data.call.tail ? OP_TAIL_CALL : OP_CALL, 1 - argc);
+        emit(c, name_constant(c, node->data.call.name));
+    }
+    emit(c, argc);
+}
+
+static void compile_binop(Compiler* c, ASTNode* node) {
+    static const OpCode ops[] = {
+        [BINOP_ADD] = OP_ADD, [BINOP_SUB] = OP_SUB, [BINOP_MUL] = OP_MUL, [BINOP_DIV] = OP_DIV,
+        [BINOP_EQ] = OP_EQ, [BINOP_NEQ] = OP_NEQ, [BINOP_LT] = OP_LT, [BINOP_LE] = OP_LE,
+        [BINOP_GT] = OP_GT, [BINOP_GE] = OP_GE
+    };
+    compile_node(c, node->data.binop.left);
+    compile_node(c, node->data.binop.right);
+    emit_op(c, ops[node->data.binop.op], -1);
+    if (node->data.binop.op >= BINOP_EQ) {
+        // Comparisons can quicken into a fused compare-and-branch
+        emit(c, options.quicken_stats ? quick_site_new(node->line, node->data.binop.op)->index : QUICK_NO_SITE);
+    }
+}
+
+static void compile_each(Compiler* c, ASTNode* node) {
+    int scope = node->data.each.global ? SCOPE_GLOBAL : SCOPE_LOCAL;
+    Loop loop = {0};
+    int exit_jump;
+
+    if (node->data.each.range_start) {
+        // Stack while looping: [counter, end]
+        compile_node(c, node->data.each.range_start);
+        compile_node(c, node->data.each.range_end);
+        emit_op(c, OP_RANGE_INIT, 0);
+        loop.continue_target = c->chunk->count;
+        emit_op(c, OP_RANGE_NEXT, 0);
+    } else {
+        // Stack while looping: [list or dict, index]
+        compile_node(c, node->data.each.iterable);
+        emit_op(c, OP_LIST_INIT, 1);
+        loop.continue_target = c->chunk->count;
+        emit_op(c, OP_LIST_NEXT, 0);
+    }
+    emit(c, scope);
+    emit(c, node->data.each.slot);
+    emit(c, -1);
+    exit_jump = c->chunk->count - 1;
+
+    compile_loop_body(c, &loop, node->data.each.body, node->data.each.body_count);
+    emit_op(c, OP_JUMP, 0);
+    emit(c, loop.continue_target);
+
+    patch_jump(c, exit_jump);
+    patch_breaks(c, &loop);
+    emit_op(c, OP_POP, -1);
+    emit_op(c, OP_POP, -1);
+}
+
+static void compile_node(Compiler* c, ASTNode* node) {
+    int saved_line = c->line;
+    c->line = node->line;
+
+    switch (node->type) {
+    case AST_PROGRAM:
+        compile_block(c, node->data.list.items, node->data.list.count);
+        break;
+    case AST_NUMBER:
+        emit_op(c, OP_CONSTANT, 1);
+        emit(c, add_constant(c, create_constant(node)));
+        break;
+    case AST_STRING:
+        // Top-level chunks are freed after running with --stream, so their
+        // strings are copied rather than handed out
+        emit_op(c, options.stream && !c->in_function ? OP_STRING : OP_CONSTANT, 1);
+        emit(c, add_constant(c, create_constant(node)));
+        break;
+    case AST_BOOLEAN:
+        emit_op(c, node->data.boolean ? OP_TRUE : OP_FALSE, 1);
+        break;
+    case AST_NULL:
+        emit_op(c, OP_NULL, 1);
+        break;
+    case AST_VAR:
+        emit_get(c, node->data.var.slot, node->data.var.global);
+        break;
+    case AST_ASSIGN:
+        compile_node(c, node->data.assign.value);
+        if (node->data.assign.index == NULL) {
+            emit_op(c, node->data.assign.global ? OP_SET_GLOBAL : OP_SET_LOCAL, 0);
+            emit(c, node->data.assign.slot);
+        } else {
+            emit_get(c, node->data.assign.slot, node->data.assign.global);
+            compile_node(c, node->data.assign.index);
+            emit_op(c, OP_SET_INDEX, -2);
+            emit(c, name_constant(c, node->data.assign.name));
+        }
+        break;
+    case AST_INDEX:
+        emit_get(c, node->data.index.slot, node->data.index.global);
+        compile_node(c, node->data.index.index);
+        emit_op(c, OP_GET_INDEX, -1);
+        emit(c, name_constant(c, node->data.index.target));
+        break;
+    case AST_BINOP:
+        compile_binop(c, node);
+        break;
+    case AST_UNARYOP:
+        compile_node(c, node->data.unaryop.operand);
+        emit_op(c, OP_NEGATE, 0);
+        break;
+    case AST_LIST:
+        for (int i = 0; i < node->data.list.count; i++) {
+            compile_node(c, node->data.list.items[i]);
+        }
+        emit_op(c, OP_LIST, 1 - node->data.list.count);
+        emit(c, node->data.list.count);
+        break;
+    case AST_DICT:
+        for (int i = 0; i < node->data.dict.count; i++) {
+            compile_node(c, node->data.dict.keys[i]);
+            compile_node(c, node->data.dict.values[i]);
+        }
+        emit_op(c, OP_DICT, 1 - 2 * node->data.dict.count);
+        emit(c, node->data.dict.count);
+        break;
+    case AST_CALL:
+        compile_call(c, node);
+        break;
+    case AST_EXPRSTMT:
+        compile_node(c, node->data.expr);
+        emit_op(c, OP_POP, -1);
+        break;
+    case AST_IF: {
+        compile_node(c, node->data.if_stmt.condition);
+        int else_jump = emit_jump(c, OP_JUMP_IF_FALSE, -1);
+        emit(c, COND_IF);
+        compile_block(c, node->data.if_stmt.then_body, node->data.if_stmt.then_body_count);
+        if (node->data.if_stmt.else_body) {
+            int end_jump = emit_jump(c, OP_JUMP, 0);
+            patch_jump(c, else_jump);
+            compile_block(c, node->data.if_stmt.else_body, node->data.if_stmt.else_body_count);
+            patch_jump(c, end_jump);
+        } else {
+            patch_jump(c, else_jump);
+        }
+        break;
+    }
+    case AST_LOOP: {
+        Loop loop = {0};
+        loop.continue_target = c->chunk->count;
+        compile_node(c, node->data.loop.condition);
+        int exit_jump = emit_jump(c, OP_JUMP_IF_FALSE, -1);
+        emit(c, COND_LOOP);
+        compile_loop_body(c, &loop, node->data.loop.body, node->data.loop.body_count);
+        emit_op(c, OP_JUMP, 0);
+        emit(c, loop.continue_target);
+        patch_jump(c, exit_jump);
+        patch_breaks(c, &loop);
+        break;
+    }
+    case AST_EACH:
+        compile_each(c, node);
+        break;
+    case AST_BREAK:
+        // 'stop' outside of a loop does nothing
+        if (c->loop) {
+            add_patch(&c->loop->breaks, emit_jump(c, OP_JUMP, 0));
+        }
+        break;
+    case AST_CONTINUE:
+        if (c->loop) {
+            emit_op(c, OP_JUMP, 0);
+            emit(c, c->loop->continue_target);
+        }
+        break;
+    case AST_RETURN:
+        compile_node(c, node->data.expr);
+        if (node->data.expr->type == AST_CALL && node->data.expr->data.call.tail) {
+            // The callee returns straight to our caller
+            c->depth--;
+        } else if (c->in_function) {
+            emit_op(c, OP_RETURN, -1);
+        } else {
+            // 'give' at the top level just evaluates its value
+            emit_op(c, OP_POP, -1);
+        }
+        break;
+    case AST_FUNCDEF: {
+        Chunk* chunk = c->chunk;
+        if (chunk->function_count >= chunk->function_capacity) {
+            chunk->function_capacity = chunk->function_capacity ? chunk->function_capacity * 2 : 8;
+            chunk->functions = realloc(chunk->functions, sizeof(FunctionProto*) * chunk->function_capacity);
+        }
+        chunk->functions[chunk->function_count] = compile_function(node);
+        emit_op(c, OP_DEF, 0);
+        emit(c, chunk->function_count++);
+        break;
+    }
+    default:
+        fprintf(stderr, "Unknown AST node type: %d\n", node->type);
+        exit(1);
+    }
+
+    c->line = saved_line;
+}
+
+Chunk* compile_program(ASTNode* program) {
+    Compiler c = {0};
+    c.chunk = new_chunk();
+    c.line = program->line;
+    compile_node(&c, program);
+    emit_op(&c, OP_HALT, 0);
+    atom_map_free(&c.names);
+    return c.chunk;
+}
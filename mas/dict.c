@@ -0,0 +1,170 @@
+// dict.c
+#include "mas.h"
+
+// Dictionaries are open-addressing hash tables with linear probing. The
+// capacity is a power of two and the table grows before it is 3/4 full.
+// Deletion shifts the following entries of the probe run back instead of
+// leaving tombstones, so lookups never have to skip dead entries.
+//
+// An entry whose key is null is empty (null is not a valid key). Keys are
+// strings or numbers; strings cache their hash in the object.
+
+#define DICT_MIN_CAPACITY 8
+
+// FNV-1a, computed once per string object
+uint32_t string_hash(MASObject* string) {
+    if (string->data.hash == 0) {
+        uint32_t hash = 2166136261u;
+        for (const char* c = string->data.string; *c; c++) {
+            hash ^= (unsigned char)*c;
+            hash *= 16777619u;
+        }
+        string->data.hash = hash ? hash : 1;
+    }
+    return string->data.hash;
+}
+
+static uint32_t hash_key(Value key) {
+    if (IS_STRING(key)) {
+        return string_hash(AS_OBJ(key));
+    }
+    double number = AS_NUMBER(key);
+    if (number == 0) number = 0;           // -0 and 0 are the same key
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static bool keys_equal(Value a, Value b) {
+    if (IS_NUMBER(a) || IS_NUMBER(b)) {
+        return IS_NUMBER(a) && IS_NUMBER(b) && AS_NUMBER(a) == AS_NUMBER(b);
+    }
+    if (a == b) return true;
+    MASObject* x = AS_OBJ(a);
+    MASObject* y = AS_OBJ(b);
+    return string_hash(x) == string_hash(y) && strcmp(x->data.string, y->data.string) == 0;
+}
+
+void dict_check_key(Value key) {
+    if (!IS_NUMBER(key) && !IS_STRING(key)) {
+        fprintf(stderr, "Dictionary keys must be strings or numbers\n");
+        exit(1);
+    }
+}
+
+// The entry holding 'key', or the empty entry where it would go
+static DictEntry* find_entry(DictEntry* entries, int capacity, Value key) {
+    uint32_t mask = (uint32_t)capacity - 1;
+    for (uint32_t i = hash_key(key) & mask;; i = (i + 1) & mask) {
+        if (IS_NULL(entries[i].key) || keys_equal(entries[i].key, key)) {
+            return &entries[i];
+        }
+    }
+}
+
+static void clear_entries(DictEntry* entries, int capacity) {
+    for (int i = 0; i < capacity; i++) {
+        entries[i].key = NULL_VAL;
+        entries[i].value = NULL_VAL;
+    }
+}
+
+// Re-shade an entry that moved to another slot: an incremental mark may
+// already have scanned the part of the table it moved into
+static void entry_moved(MASObject* dict, DictEntry* entry) {
+    gc_write_barrier(dict, entry->key);
+    gc_write_barrier(dict, entry->value);
+}
+
+// Rehashing allocates through the GC without collecting, so no object moves
+static void dict_resize(MASObject* dict, int capacity) {
+    DictEntry* old_entries = dict->data.dict.entries;
+    int old_capacity = dict->data.dict.capacity;
+
+    DictEntry* entries = gc_alloc_payload(dict, sizeof(DictEntry) * capacity);
+    clear_entries(entries, capacity);
+    for (int i = 0; i < old_capacity; i++) {
+        if (!IS_NULL(old_entries[i].key)) {
+            DictEntry* entry = find_entry(entries, capacity, old_entries[i].key);
+            *entry = old_entries[i];
+            if (gc_marking) entry_moved(dict, entry);
+        }
+    }
+
+    gc_free_payload(old_entries, sizeof(DictEntry) * old_capacity);
+    dict->data.dict.entries = entries;
+    dict->data.dict.capacity = capacity;
+}
+
+Value create_dict(int expected) {
+    int capacity = 0;
+    if (expected > 0) {
+        capacity = DICT_MIN_CAPACITY;
+        while (expected > capacity * 3 / 4) capacity *= 2;
+    }
+    MASObject* obj = allocate_object(AST_DICT, sizeof(DictEntry) * capacity);
+    obj->data.dict.count = 0;
+    obj->data.dict.capacity = capacity;
+    clear_entries(obj->data.dict.entries, capacity);
+    return OBJ_VAL(obj);
+}
+
+bool dict_get(MASObject* dict, Value key, Value* value) {
+    if (dict->data.dict.count == 0) return false;
+    DictEntry* entry = find_entry(dict->data.dict.entries, dict->data.dict.capacity, key);
+    if (IS_NULL(entry->key)) return false;
+    *value = entry->value;
+    return true;
+}
+
+void dict_set(MASObject* dict, Value key, Value value) {
+    if (dict->data.dict.count + 1 > dict->data.dict.capacity * 3 / 4) {
+        int capacity = dict->data.dict.capacity ? dict->data.dict.capacity * 2 : DICT_MIN_CAPACITY;
+        dict_resize(dict, capacity);
+    }
+    DictEntry* entry = find_entry(dict->data.dict.entries, dict->data.dict.capacity, key);
+    if (IS_NULL(entry->key)) {
+        entry->key = key;
+        dict->data.dict.count++;
+        gc_write_barrier(dict, key);
+    }
+    entry->value = value;
+    gc_write_barrier(dict, value);
+}
+
+bool dict_delete(MASObject* dict, Value key) {
+    if (dict->data.dict.count == 0) return false;
+    DictEntry* entries = dict->data.dict.entries;
+    uint32_t mask = (uint32_t)dict->data.dict.capacity - 1;
+    uint32_t hole = (uint32_t)(find_entry(entries, dict->data.dict.capacity, key) - entries);
+    if (IS_NULL(entries[hole].key)) return false;
+
+    // Move later entries of the run back into the hole when their home slot
+    // does not lie (cyclically) between the hole and where they are now
+    for (uint32_t i = (hole + 1) & mask; !IS_NULL(entries[i].key); i = (i + 1) & mask) {
+        uint32_t home = hash_key(entries[i].key) & mask;
+        bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+        if (!stays) {
+            entries[hole] = entries[i];
+            if (gc_marking) entry_moved(dict, &entries[hole]);
+            hole = i;
+        }
+    }
+    entries[hole].key = NULL_VAL;
+    entries[hole].value = NULL_VAL;
+    dict->data.dict.count--;
+    return true;
+}
+
+// Index of the first used entry at or after 'index', or -1. Iteration
+// order is table order; changing a dictionary while iterating over it may
+// skip or repeat keys but is otherwise safe.
+int dict_next(MASObject* dict, int index) {
+    for (; index < dict->data.dict.capacity; index++) {
+        if (!IS_NULL(dict->data.dict.entries[index].key)) return index;
+    }
+    return -1;
+}
@@ -0,0 +1,599 @@
+// gc.c
+#include "mas.h"
+#include <time.h>
+
+// Generational collector. New objects are bump-allocated in a fixed-size
+// nursery together with their string bytes or list items. When the nursery
+// fills up, a minor collection copies the young objects that are reachable
+// from the roots or from the remembered set into the old space and resets
+// the nursery, so its cost depends only on what survives.
+//
+// A young list or dictionary that outgrows the space left in the nursery
+// moves its payload to the slab allocator. Such external payloads are
+// handed over to the copy when the object is promoted and freed when it
+// dies young.
+//
+// Old objects are reclaimed by a mark-and-sweep major collection. It starts
+// once promotions push the old space past a threshold that grows with the
+// amount of live data, or explicitly through gc().
+//
+// With a pause target (--gc-max-pause-us) major collections run
+// incrementally: after each minor collection the collector marks and then
+// sweeps for at most that long before handing control back. Marking is
+// tri-color. Marked lists on the gray stack still have to be scanned.
+// Marked objects off the stack are black. The write barrier shades any
+// white object stored into the heap while marking is in progress. Roots and
+// the nursery are not barriered, so marking ends with a short remark pause
+// that empties the nursery and rescans the roots.
+
+GCConfig gc_config = {
+    .threshold = 1024 * 1024,
+    .growth = 2.0,
+    .nursery = 256 * 1024,
+    .max_pause_us = 0,
+    .stress = false,
+    .stats = false,
+};
+
+// Growable stack of object pointers
+typedef struct {
+    MASObject** items;
+    int count;
+    int capacity;
+} ObjectStack;
+
+static void object_stack_push(ObjectStack* stack, MASObject* obj) {
+    if (stack->count >= stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 64;
+        stack->items = realloc(stack->items, sizeof(MASObject*) * stack->capacity);
+    }
+    stack->items[stack->count++] = obj;
+}
+
+// Nursery
+static char* nursery = NULL;
+static char* nursery_top = NULL;
+static char* nursery_end = NULL;
+static int young_count = 0;           // objects allocated since the last minor collection
+
+// Old space
+static ObjectStack old_objects;
+static size_t heap_bytes = 0;         // bytes held by old objects, live or not
+static size_t next_gc = 0;            // major collection when heap_bytes passes this
+
+static ObjectStack remembered;        // old objects that may point into the nursery
+static ObjectStack promoted;          // promoted containers whose values still need forwarding
+static ObjectStack external;          // young containers whose payload lives outside the nursery
+static Interpreter* active_interp = NULL;
+
+// What gc_visit_roots does with each root slot
+static enum { VISIT_SHADE, VISIT_FORWARD } root_visit = VISIT_SHADE;
+
+// Marking never recurses: marked containers wait on an explicit gray stack.
+// Each entry is a range of at most MARK_CHUNK values, so one huge list is
+// scanned in pieces and the rest of it is only pushed back while its
+// children are scanned first.
+#define MARK_CHUNK 256
+
+typedef struct {
+    MASObject* obj;
+    int start;
+} GrayRange;
+
+// Major collection state
+static enum { GC_IDLE, GC_MARKING, GC_SWEEPING } phase = GC_IDLE;
+bool gc_marking = false;              // phase == GC_MARKING, read by the write barrier
+static struct {
+    GrayRange* items;
+    int count;
+    int capacity;
+} gray;                               // ranges of marked containers not scanned yet
+static int sweep_cursor = 0;          // next object to look at
+static int sweep_kept = 0;            // survivors compacted to the front so far
+static int sweep_end = 0;             // objects promoted after this index are not swept
+static int sweep_freed = 0;
+
+static struct {
+    int collections;
+    int minor_collections;
+    size_t objects_freed;
+    size_t bytes_freed;
+    size_t bytes_promoted;
+    size_t peak_heap_bytes;
+    double total_ms;
+    double minor_ms;
+    double max_pause_ms;
+    int increments;
+} stats;
+
+static double elapsed_ms(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static void record_pause(double ms) {
+    stats.total_ms += ms;
+    if (ms > stats.max_pause_ms) stats.max_pause_ms = ms;
+}
+
+#define ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+static size_t payload_size(MASObject* obj) {
+    if (obj->type == AST_STRING) {
+        return strlen(obj->data.string) + 1;
+    } else if (obj->type == AST_LIST) {
+        return sizeof(Value) * obj->data.list.capacity;
+    } else if (obj->type == AST_DICT) {
+        return sizeof(DictEntry) * obj->data.dict.capacity;
+    }
+    return 0;
+}
+
+static void* payload_of(MASObject* obj) {
+    if (obj->type == AST_STRING) {
+        return obj->data.string;
+    } else if (obj->type == AST_LIST) {
+        return obj->data.list.items;
+    } else if (obj->type == AST_DICT) {
+        return obj->data.dict.entries;
+    }
+    return NULL;
+}
+
+// The values an object refers to: list items, or dictionary keys and values
+// (an entry is a key followed by its value, so the entries form one array)
+static Value* object_values(MASObject* obj, int* count) {
+    if (obj->type == AST_LIST) {
+        *count = obj->data.list.count;
+        return obj->data.list.items;
+    } else if (obj->type == AST_DICT) {
+        *count = obj->data.dict.capacity * 2;
+        return (Value*)obj->data.dict.entries;
+    }
+    *count = 0;
+    return NULL;
+}
+
+static bool in_nursery(void* ptr) {
+    return (char*)ptr >= nursery && (char*)ptr < nursery_end;
+}
+
+static void attach_payload(MASObject* obj, void* payload) {
+    if (obj->type == AST_STRING) {
+        obj->data.string = payload;
+    } else if (obj->type == AST_LIST) {
+        obj->data.list.items = payload;
+    } else if (obj->type == AST_DICT) {
+        obj->data.dict.entries = payload;
+    }
+}
+
+static void free_object(MASObject* obj) {
+    slab_free(payload_of(obj), payload_size(obj));
+    slab_free_object(obj);
+}
+
+void gc_config_from_env() {
+    const char* value;
+    if ((value = getenv("MAS_GC_THRESHOLD"))) gc_config.threshold = strtoull(value, NULL, 10);
+    if ((value = getenv("MAS_GC_GROWTH"))) gc_config.growth = strtod(value, NULL);
+    if ((value = getenv("MAS_GC_NURSERY"))) gc_config.nursery = strtoull(value, NULL, 10);
+    if ((value = getenv("MAS_GC_MAX_PAUSE_US"))) gc_config.max_pause_us = strtol(value, NULL, 10);
+    if ((value = getenv("MAS_GC_STRESS"))) gc_config.stress = atoi(value) != 0;
+    if ((value = getenv("MAS_GC_STATS"))) gc_config.stats = atoi(value) != 0;
+}
+
+void gc_set_interpreter(Interpreter* interp) {
+    active_interp = interp;
+}
+
+static void gray_push(MASObject* obj, int start) {
+    if (gray.count >= gray.capacity) {
+        gray.capacity = gray.capacity ? gray.capacity * 2 : 256;
+        gray.items = realloc(gray.items, sizeof(GrayRange) * gray.capacity);
+    }
+    gray.items[gray.count].obj = obj;
+    gray.items[gray.count].start = start;
+    gray.count++;
+}
+
+// Old objects keep their header and payload in separate slab cells.
+// Objects created while marking is in progress start out black.
+static MASObject* allocate_old(ASTType type, size_t payload) {
+    MASObject* obj = slab_alloc_object();
+    obj->type = type;
+    obj->marked = gc_marking;
+    attach_payload(obj, slab_alloc(payload));
+    object_stack_push(&old_objects, obj);
+
+    heap_bytes += sizeof(MASObject) + payload;
+    if (heap_bytes > stats.peak_heap_bytes) stats.peak_heap_bytes = heap_bytes;
+    return obj;
+}
+
+// Copy a young object into the old space and leave a forwarding pointer behind
+static MASObject* promote(MASObject* obj) {
+    size_t payload = payload_size(obj);
+    MASObject* copy;
+    if (payload && !in_nursery(payload_of(obj))) {
+        // External payloads are already in the old space (and counted there)
+        copy = allocate_old(obj->type, 0);
+        copy->data = obj->data;
+    } else {
+        copy = allocate_old(obj->type, payload);
+        void* copied = payload_of(copy);
+        copy->data = obj->data;   // counts, capacity, cached hash
+        attach_payload(copy, copied);
+        if (payload) memcpy(copied, payload_of(obj), payload);
+    }
+    if (obj->type != AST_STRING) {
+        object_stack_push(&promoted, copy);
+        if (gc_marking) {
+            // Its values may be white old objects the barrier never saw
+            gray_push(copy, 0);
+        }
+    }
+    stats.bytes_promoted += sizeof(MASObject) + payload;
+
+    obj->forwarded = true;
+    obj->data.forward = copy;
+    return copy;
+}
+
+static void forward(Value* slot) {
+    if (!IS_OBJ(*slot)) return;
+    MASObject* obj = AS_OBJ(*slot);
+    if (!obj->young) return;
+    *slot = OBJ_VAL(obj->forwarded ? obj->data.forward : promote(obj));
+}
+
+static void forward_values(MASObject* obj) {
+    int count;
+    Value* values = object_values(obj, &count);
+    for (int i = 0; i < count; i++) {
+        forward(&values[i]);
+    }
+}
+
+// Turn a white old object gray. Young objects are left to the remark pause,
+// since a minor collection may move them before the gray stack gets to them.
+void gc_shade(MASObject* obj) {
+    if (!obj->marked && !obj->young) {
+        obj->marked = true;
+        if (obj->type != AST_STRING) {
+            gray_push(obj, 0);
+        }
+    }
+}
+
+// Root slots are forwarded during a minor collection and shaded during a
+// major one
+void gc_visit_roots(Value* slots, int count) {
+    for (int i = 0; i < count; i++) {
+        if (root_visit == VISIT_FORWARD) {
+            forward(&slots[i]);
+        } else if (IS_OBJ(slots[i])) {
+            gc_shade(AS_OBJ(slots[i]));
+        }
+    }
+}
+
+static void gc_mark_roots(Interpreter* interp) {
+    // (gc_visit_roots decides whether the slots are shaded or forwarded)
+    // Globals
+    gc_visit_roots(interp->globals, interp->global_count);
+    // Locals of the running function and of every caller waiting on it
+    gc_visit_roots(interp->frames, interp->frame_top);
+    gc_visit_roots(&interp->return_value, 1);
+    // Temporaries the tree walker has evaluated but not yet stored anywhere
+    gc_visit_roots(interp->roots, interp->root_count);
+    // The VM stack, which also holds the locals of every active call
+    if (interp->vm) {
+        vm_mark_roots(interp->vm);
+    }
+}
+
+void gc_remember(MASObject* obj) {
+    obj->remembered = true;
+    object_stack_push(&remembered, obj);
+}
+
+// Empty the nursery; returns the number of young objects that died
+static int minor_collect(Interpreter* interp) {
+    clock_t start = clock();
+    int promoted_before = old_objects.count;
+
+    root_visit = VISIT_FORWARD;
+    gc_mark_roots(interp);
+    for (int i = 0; i < remembered.count; i++) {
+        remembered.items[i]->remembered = false;
+        forward_values(remembered.items[i]);
+    }
+    remembered.count = 0;
+    while (promoted.count > 0) {
+        forward_values(promoted.items[--promoted.count]);
+    }
+    root_visit = VISIT_SHADE;
+
+    // Free the external payloads of young containers that died
+    for (int i = 0; i < external.count; i++) {
+        MASObject* obj = external.items[i];
+        if (!obj->forwarded) {
+            gc_free_payload(payload_of(obj), payload_size(obj));
+        }
+    }
+    external.count = 0;
+
+    int died = young_count - (old_objects.count - promoted_before);
+    if (gc_config.stress) {
+        // Make stale pointers into the nursery fail loudly
+        memset(nursery, 0xdb, nursery_top - nursery);
+    }
+    nursery_top = nursery;
+    young_count = 0;
+
+    stats.minor_collections++;
+    stats.objects_freed += died;
+    double ms = elapsed_ms(start);
+    stats.minor_ms += ms;
+    record_pause(ms);
+    return died;
+}
+
+// Scan gray ranges until none are left or the deadline passes (0 = no
+// deadline). Returns true once the gray stack is empty.
+static bool mark_step(clock_t deadline) {
+    int scanned = 0;
+    while (gray.count > 0) {
+        GrayRange range = gray.items[--gray.count];
+        int count;
+        Value* values = object_values(range.obj, &count);
+
+        // The list may have shrunk since the range was pushed
+        int end = range.start + MARK_CHUNK;
+        if (end < count) {
+            gray_push(range.obj, end);
+        } else {
+            end = count;
+        }
+        for (int i = range.start; i < end; i++) {
+            if (IS_OBJ(values[i])) gc_shade(AS_OBJ(values[i]));
+        }
+
+        if (deadline && ++scanned % 16 == 0 && clock() >= deadline) {
+            return gray.count == 0;
+        }
+    }
+    return true;
+}
+
+static void start_sweep() {
+    phase = GC_SWEEPING;
+    gc_marking = false;
+    sweep_cursor = 0;
+    sweep_kept = 0;
+    sweep_end = old_objects.count;
+    sweep_freed = 0;
+}
+
+// Free unmarked objects until the deadline passes (0 = no deadline).
+// Returns true once the sweep is complete.
+static bool sweep_step(clock_t deadline) {
+    while (sweep_cursor < sweep_end) {
+        MASObject* obj = old_objects.items[sweep_cursor++];
+        if (obj->marked) {
+            obj->marked = false; // reset for next cycle
+            old_objects.items[sweep_kept++] = obj;
+        } else {
+            size_t size = sizeof(MASObject) + payload_size(obj);
+            heap_bytes -= size;
+            stats.bytes_freed += size;
+            free_object(obj);
+            sweep_freed++;
+        }
+        if (deadline && sweep_cursor % 256 == 0 && clock() >= deadline) {
+            return false;
+        }
+    }
+
+    // Keep the objects promoted while the sweep was in progress
+    for (int i = sweep_end; i < old_objects.count; i++) {
+        old_objects.items[sweep_kept++] = old_objects.items[i];
+    }
+    old_objects.count = sweep_kept;
+    return true;
+}
+
+static void finish_cycle() {
+    phase = GC_IDLE;
+
+    // Let the heap grow in proportion to what survived
+    next_gc = (size_t)(heap_bytes * gc_config.growth);
+    if (next_gc < gc_config.threshold) next_gc = gc_config.threshold;
+
+    stats.collections++;
+    stats.objects_freed += sweep_freed;
+}
+
+// Finish marking. The roots were not covered by the write barrier and
+// neither was the nursery, which the caller must have emptied first.
+static void remark(Interpreter* interp) {
+    root_visit = VISIT_SHADE;
+    gc_mark_roots(interp);
+    root_visit = VISIT_SHADE;
+    mark_step(0);
+}
+
+// Do one bounded increment of an incremental major collection
+static void gc_step(Interpreter* interp) {
+    clock_t start = clock();
+    clock_t deadline = start + (clock_t)((double)gc_config.max_pause_us * CLOCKS_PER_SEC / 1e6);
+    if (deadline == 0) deadline = 1;
+    double minor_before = stats.minor_ms;
+
+    if (phase == GC_IDLE) {
+        phase = GC_MARKING;
+        gc_marking = true;
+        root_visit = VISIT_SHADE;
+        gc_mark_roots(interp);
+        root_visit = VISIT_SHADE;
+    }
+    if (phase == GC_MARKING && mark_step(deadline)) {
+        minor_collect(interp);
+        remark(interp);
+        start_sweep();
+    }
+    if (phase == GC_SWEEPING && clock() < deadline && sweep_step(deadline)) {
+        finish_cycle();
+    }
+
+    // The pause includes the remark's minor collection, which has already
+    // been added to the total
+    double ms = elapsed_ms(start);
+    stats.increments++;
+    stats.total_ms += ms - (stats.minor_ms - minor_before);
+    if (ms > stats.max_pause_ms) stats.max_pause_ms = ms;
+}
+
+// Stop-the-world collection, finishing any incremental cycle in progress
+void gc_collect(Interpreter* interp, bool verbose) {
+    // Promote every live young object so the whole heap is old
+    int collected = minor_collect(interp);
+    clock_t start = clock();
+
+    if (phase == GC_SWEEPING) {
+        sweep_step(0);
+        finish_cycle();
+        collected += sweep_freed;
+    }
+
+    // Mark from the roots, or finish the incremental marking in progress
+    remark(interp);
+
+    start_sweep();
+    sweep_step(0);
+    finish_cycle();
+    collected += sweep_freed;
+
+    record_pause(elapsed_ms(start));
+    if (verbose) {
+        printf("[GC] Collected %d objects (remaining: %d)\n", collected, old_objects.count);
+    }
+}
+
+// Allocate a new payload for 'obj' (a list or dictionary that is growing).
+// Never collects, so callers may hold object pointers across it. The old
+// payload stays valid until it is released with gc_free_payload.
+void* gc_alloc_payload(MASObject* obj, size_t size) {
+    void* current = payload_of(obj);
+    if (obj->young && size <= gc_config.nursery / 4 && (size_t)(nursery_end - nursery_top) >= ALIGN(size)) {
+        void* payload = nursery_top;
+        nursery_top += ALIGN(size);
+        return payload;
+    }
+
+    void* payload = slab_alloc(size);
+    heap_bytes += size;
+    if (heap_bytes > stats.peak_heap_bytes) stats.peak_heap_bytes = heap_bytes;
+    if (obj->young && (current == NULL || in_nursery(current))) {
+        object_stack_push(&external, obj);
+    }
+    return payload;
+}
+
+// Nursery payloads are reclaimed by the next minor collection
+void gc_free_payload(void* payload, size_t size) {
+    if (payload && !in_nursery(payload)) {
+        slab_free(payload, size);
+        heap_bytes -= size;
+    }
+}
+
+// Make room for at least 'capacity' items, growing geometrically
+void gc_reserve_list(MASObject* list, int capacity) {
+    if (capacity <= list->data.list.capacity) return;
+
+    int new_capacity = list->data.list.capacity < 4 ? 4 : list->data.list.capacity;
+    while (new_capacity < capacity) new_capacity *= 2;
+
+    Value* items = gc_alloc_payload(list, sizeof(Value) * new_capacity);
+    if (list->data.list.count) {
+        memcpy(items, list->data.list.items, sizeof(Value) * list->data.list.count);
+    }
+    gc_free_payload(list->data.list.items, payload_size(list));
+    list->data.list.items = items;
+    list->data.list.capacity = new_capacity;
+}
+
+// Called whenever the old space has grown
+static void gc_maybe_collect(Interpreter* interp) {
+    if (phase != GC_IDLE) {
+        // Finish in one go if the mutator is allocating faster than we collect
+        if (heap_bytes > next_gc * 2) {
+            gc_collect(interp, false);
+        } else {
+            gc_step(interp);
+        }
+    } else if (heap_bytes > next_gc) {
+        if (gc_config.max_pause_us > 0) {
+            gc_step(interp);
+        } else {
+            gc_collect(interp, false);
+        }
+    }
+}
+
+// Allocate an object with room for 'payload' bytes of string data or list
+// items. The payload pointer is set up; the caller fills in the contents.
+MASObject* allocate_object(ASTType type, size_t payload) {
+    if (!nursery) {
+        if (gc_config.nursery < 4096) gc_config.nursery = 4096;
+        nursery = malloc(gc_config.nursery);
+        nursery_top = nursery;
+        nursery_end = nursery + gc_config.nursery;
+        next_gc = gc_config.threshold;
+    }
+    if (active_interp && gc_config.stress) {
+        gc_collect(active_interp, false);
+    }
+
+    size_t size = ALIGN(sizeof(MASObject) + payload);
+    if (size > gc_config.nursery / 4) {
+        // Too big to be worth copying: allocate straight into the old space
+        if (active_interp) {
+            gc_maybe_collect(active_interp);
+        }
+        return allocate_old(type, payload);
+    }
+
+    if ((size_t)(nursery_end - nursery_top) < size) {
+        if (!active_interp) {
+            return allocate_old(type, payload);
+        }
+        minor_collect(active_interp);
+        gc_maybe_collect(active_interp);
+    }
+
+    MASObject* obj = (MASObject*)nursery_top;
+    nursery_top += size;
+    young_count++;
+
+    memset(obj, 0, sizeof(MASObject));
+    obj->type = type;
+    obj->young = true;
+    attach_payload(obj, payload ? (void*)(obj + 1) : NULL);
+    return obj;
+}
+
+void gc_print_stats() {
+    fprintf(stderr, "[GC] major collections: %d, minor collections: %d, objects freed: %zu\n",
+            stats.collections, stats.minor_collections, stats.objects_freed);
+    fprintf(stderr, "[GC] bytes promoted: %zu, old bytes freed: %zu\n",
+            stats.bytes_promoted, stats.bytes_freed);
+    fprintf(stderr, "[GC] old space: %zu bytes in %d objects (peak %zu bytes), next major collection at %zu bytes\n",
+            heap_bytes, old_objects.count, stats.peak_heap_bytes, next_gc);
+    fprintf(stderr, "[GC] nursery: %zu of %zu bytes in use\n",
+            (size_t)(nursery_top - nursery), gc_config.nursery);
+    slab_print_stats();
+    fprintf(stderr, "[GC] total collection time: %.3f ms (minor %.3f ms), longest pause: %.3f ms, increments: %d\n",
+            stats.total_ms, stats.minor_ms, stats.max_pause_ms, stats.increments);
+}
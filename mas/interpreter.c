@@ -1,219 +1,154 @@
     // interpreter.c
     #include "mas.h"
 
-    typedef struct
-    {
-        char **names;
-        MASObject **values;
-        int count;
-        int capacity;
-    } SymbolTable;
-
-    typedef struct
-    {
-        SymbolTable *globals;
-        SymbolTable *locals;
-        struct {
-            char** names;
-            ASTNode** funcs;
-            int count;
-            int capacity;
-        } functions;
-    } Interpreter;
-
-    static MASObject *builtin_input(Interpreter *interp, MASObject **args, int arg_count);
-    static MASObject *evaluate(ASTNode *node, Interpreter *interp);
-    static MASObject *create_number(double value);
-    static MASObject *create_string(const char *value);
-    static MASObject *create_boolean(bool value);
-    static MASObject *create_null();
-    static MASObject *create_list(MASObject **items, int count);
-    void interpreter_add_function(Interpreter* interp, const char* name, ASTNode* func);
-    static void gc_add_object(MASObject* obj);
-    static MASObject* allocate_object(size_t size);
-    static MASObject *builtin_gc(Interpreter *interp, MASObject **args, int arg_count);
-    static void gc_collect(Interpreter* interp);
-    static void gc_sweep();
-    static void gc_mark_roots(Interpreter* interp);
-    static void gc_mark(MASObject* obj);
-
-
-    static MASObject** all_objects = NULL;
-    static int object_count = 0;
-    static int object_capacity = 0;
-
-    //Global Object list
-    static void gc_add_object(MASObject* obj) {
-        if (object_count >= object_capacity) {
-            object_capacity = object_capacity ? object_capacity * 2 : 16;
-            all_objects = realloc(all_objects, sizeof(MASObject*) * object_capacity);
-        }
-        all_objects[object_count++] = obj;
-        obj->marked = false;
-    }
-
-    static MASObject* allocate_object(size_t size) {
-        MASObject* obj = malloc(size);
-        memset(obj, 0, size);
-        gc_add_object(obj);
-        return obj;
-    }
-
-    static void gc_mark(MASObject* obj) {
-        if (!obj || obj->marked) return;
-        obj->marked = true;
-
-    // Mark children
-        if (obj->type == AST_LIST) {
-            for (int i = 0; i < obj->data.list.count; i++) {
-                gc_mark(obj->data.list.items[i]);
-            }
-        }
+    // How a statement finished. 'stop', 'next' and 'give' unwind through the
+    // enclosing blocks until the loop or call that handles them.
+    typedef enum
+    {
+        FLOW_NORMAL,
+        FLOW_BREAK,
+        FLOW_CONTINUE,
+        FLOW_RETURN,     // the value is in interp->return_value
+        FLOW_TAIL_CALL   // the frame now holds the arguments for interp->tail_function
+    } Flow;
+
+    // Whether the flow unwinds all the way out of the running call
+    static bool leaves_call(Flow flow)
+    {
+        return flow >= FLOW_RETURN;
     }
 
-    static void gc_mark_roots(Interpreter* interp) {
-    // Mark globals
-        for (int i = 0; i < interp->globals->count; i++) {
-            gc_mark(interp->globals->values[i]);
-        }
-    // Mark locals
-        for (int i = 0; i < interp->locals->count; i++) {
-            gc_mark(interp->locals->values[i]);
-        }
-    }
+    static Value builtin_input(Interpreter *interp, Value *args, int arg_count);
+    static Value evaluate(ASTNode *node, Interpreter *interp);
+    static Flow execute(ASTNode *node, Interpreter *interp);
+    static Flow execute_block(ASTNode **body, int count, Interpreter *interp);
+    void interpreter_add_function(Interpreter* interp, Atom name, ASTNode* func);
+    static Value builtin_gc(Interpreter *interp, Value *args, int arg_count);
 
-    static void gc_sweep() {
-        int collected = 0;
-        int write_index = 0;
-        for (int i = 0; i < object_count; i++) {
-            MASObject* obj = all_objects[i];
-            if (obj->marked) {
-                obj->marked = false; // reset for next cycle
-                all_objects[write_index++] = obj;
-            } else {
-            // Free the object
-                if (obj->type == AST_STRING) {
-                    free(obj->data.string);
-                } else if (obj->type == AST_LIST) {
-                    free(obj->data.list.items);
-                }
-                free(obj);
-                collected++;
-            }
+    // Keep a temporary visible to the GC until the matching pop
+    static int push_root(Interpreter *interp, Value value)
+    {
+        if (interp->root_count >= interp->root_capacity) {
+            interp->root_capacity = interp->root_capacity ? interp->root_capacity * 2 : 64;
+            interp->roots = realloc(interp->roots, sizeof(Value) * interp->root_capacity);
         }
-        object_count = write_index;
-        printf("[GC] Collected %d objects (remaining: %d)\n", collected, object_count);
+        interp->roots[interp->root_count] = value;
+        return interp->root_count++;
     }
 
-    static void gc_collect(Interpreter* interp) {
-    // Mark phase
-        gc_mark_roots(interp);
-    
-    // Sweep phase
-        gc_sweep();
-    }
-
-    // Symbol table operations
-    SymbolTable *create_symbol_table()
+    static void pop_roots(Interpreter *interp, int count)
     {
-        SymbolTable *table = malloc(sizeof(SymbolTable));
-        table->capacity = 16;
-        table->count = 0;
-        table->names = malloc(sizeof(char *) * table->capacity);
-        table->values = malloc(sizeof(MASObject *) * table->capacity);
-        return table;
+        interp->root_count -= count;
     }
 
-    void symbol_table_set(SymbolTable *table, const char *name, MASObject *value)
+    // Reserve 'count' zeroed slots (unassigned locals read as 0) on top of
+    // the frame stack and return the index of the first one
+    static int push_frame(Interpreter *interp, int count)
     {
-        // Check if name exists
-        for (int i = 0; i < table->count; i++)
-        {
-            if (strcmp(table->names[i], name) == 0)
-            {
-                table->values[i] = value;
-                return;
+        int base = interp->frame_top;
+        if (base + count > interp->frame_capacity) {
+            while (base + count > interp->frame_capacity) {
+                interp->frame_capacity = interp->frame_capacity ? interp->frame_capacity * 2 : 256;
             }
+            interp->frames = realloc(interp->frames, sizeof(Value) * interp->frame_capacity);
+            interp->locals = interp->frames + interp->frame_base;
         }
+        if (count > 0) memset(interp->frames + base, 0, sizeof(Value) * count);
+        interp->frame_top = base + count;
+        return base;
+    }
 
-        // Add new entry
-        if (table->count >= table->capacity)
-        {
-            table->capacity *= 2;
-            table->names = realloc(table->names, sizeof(char *) * table->capacity);
-            table->values = realloc(table->values, sizeof(MASObject *) * table->capacity);
-        }
-
-        table->names[table->count] = strdup(name);
-        table->values[table->count] = value;
-        table->count++;
+    // Variable slots handed out by the resolver
+    static Value *variable_slot(Interpreter *interp, int slot, bool global)
+    {
+        return global ? &interp->globals[slot] : &interp->locals[slot];
     }
 
-    MASObject *symbol_table_get(SymbolTable *table, const char *name)
+    // Bind a call site to the user-defined function it names the first time
+    // it runs. A name keeps its first definition, so the binding never goes
+    // stale: later runs of the site only test node->data.call.function.
+    static ASTNode *bind_call(ASTNode *node, Interpreter *interp)
     {
-        for (int i = 0; i < table->count; i++)
-        {
-            if (strcmp(table->names[i], name) == 0)
-            {
-                return table->values[i];
-            }
+        int index = atom_map_get(&interp->functions.names, node->data.call.name);
+        if (index < 0) {
+            fprintf(stderr, "Function not defined: %s\n", node->data.call.name);
+            exit(1);
+        }
+        ASTNode* func = interp->functions.funcs[index];
+
+        // The argument count of a site is fixed too, so it is checked once
+        if (node->data.call.arg_count != func->data.funcdef.param_count) {
+            fprintf(stderr, "Function %s expects %d arguments, got %d\n",
+                    node->data.call.name, func->data.funcdef.param_count, node->data.call.arg_count);
+            exit(1);
         }
-        return NULL;
+        node->data.call.function = func;
+        return func;
     }
 
-    // Object creation
-    static MASObject *create_number(double value)
+    // Object creation (numbers, booleans and null are immediate values)
+    Value create_string(const char *value)
     {
-        MASObject *obj = allocate_object(sizeof(MASObject));
-        obj->type = AST_NUMBER;
-        obj->data.number = value;
-        return obj;
+        MASObject *obj = allocate_object(AST_STRING, strlen(value) + 1);
+        strcpy(obj->data.string, value);
+        return OBJ_VAL(obj);
     }
 
-    static MASObject *create_string(const char *value)
+    Value create_list(Value *items, int count)
     {
-        MASObject *obj = allocate_object(sizeof(MASObject));
-        obj->type = AST_STRING;
-        obj->data.string = strdup(value);
-        return obj;
+        MASObject *obj = allocate_object(AST_LIST, sizeof(Value) * count);
+        obj->data.list.count = count;
+        obj->data.list.capacity = count;
+        for (int i = 0; i < count; i++)
+        {
+            obj->data.list.items[i] = items[i];
+            gc_write_barrier(obj, items[i]);
+        }
+        return OBJ_VAL(obj);
     }
 
-    static MASObject *create_boolean(bool value)
+    // Ranges are never materialized: items are computed from the bounds
+    Value create_range(int start, int end, int step)
     {
-        MASObject *obj = allocate_object(sizeof(MASObject));
-        obj->type = AST_BOOLEAN;
-        obj->data.boolean = value;
-        return obj;
+        MASObject *obj = allocate_object(AST_RANGE, 0);
+        obj->data.range.start = start;
+        obj->data.range.end = end;
+        obj->data.range.step = step;
+        return OBJ_VAL(obj);
     }
 
-    static MASObject *create_null()
+    int range_length(MASObject *range)
     {
-        MASObject *obj = allocate_object(sizeof(MASObject));
-        obj->type = AST_NULL;
-        return obj;
+        long long start = range->data.range.start;
+        long long end = range->data.range.end;
+        long long step = range->data.range.step;
+        long long span = step > 0 ? end - start : start - end;
+        if (span < 0)
+            return 0;
+        return (int)(span / (step > 0 ? step : -step) + 1);
     }
 
-    static MASObject *create_list(MASObject **items, int count)
+    // Literal values owned by compiled bytecode. Strings are not registered
+    // with the GC, so they stay alive for as long as the chunk that holds them.
+    Value create_constant(ASTNode *literal)
     {
-        MASObject *obj = allocate_object(sizeof(MASObject));
-        obj->type = AST_LIST;
-        obj->data.list.count = count;
-        obj->data.list.items = malloc(sizeof(MASObject *) * count);
-        for (int i = 0; i < count; i++)
-        {
-            obj->data.list.items[i] = items[i];
+        if (literal->type == AST_NUMBER) {
+            return NUMBER_VAL(literal->data.number);
         }
-        return obj;
+        MASObject *obj = calloc(1, sizeof(MASObject));
+        obj->type = AST_STRING;
+        obj->data.string = strdup(literal->data.string);
+        return OBJ_VAL(obj);
     }
 
-    static MASObject *builtin_input(Interpreter *interp, MASObject **args, int arg_count)
+    static Value builtin_input(Interpreter *interp, Value *args, int arg_count)
 {
     (void)interp;
     if (arg_count > 0) {
         // Optional prompt
-        MASObject *prompt = args[0];
-        if (prompt->type == AST_STRING) {
-            printf("%s", prompt->data.string);
+        Value prompt = args[0];
+        if (IS_STRING(prompt)) {
+            printf("%s", AS_STRING(prompt));
         }
         fflush(stdout);
     }
@@ -233,20 +168,20 @@
     return create_string(buffer);
 }
 
-static MASObject *builtin_input_num(Interpreter *interp, MASObject **args, int arg_count)
+static Value builtin_input_num(Interpreter *interp, Value *args, int arg_count)
 {
     (void)interp;
     if (arg_count > 0) {
-        MASObject *prompt = args[0];
-        if (prompt->type == AST_STRING) {
-            printf("%s", prompt->data.string);
+        Value prompt = args[0];
+        if (IS_STRING(prompt)) {
+            printf("%s", AS_STRING(prompt));
         }
         fflush(stdout);
     }
 
     char buffer[1024];
     if (!fgets(buffer, sizeof(buffer), stdin)) {
-        return create_number(0.0);
+        return NUMBER_VAL(0.0);
     }
 
     // Try to parse as number
@@ -255,202 +190,522 @@ static MASObject *builtin_input_num(Interpreter *interp, MASObject **args, int a
     if (end == buffer || (*end != '\0' && *end != '\n')) {
         // Not a valid number
         fprintf(stderr, "Warning: input is not a number, returning 0\n");
-        return create_number(0.0);
+        return NUMBER_VAL(0.0);
     }
 
-    return create_number(val);
+    return NUMBER_VAL(val);
 }
 
+    // Container items are printed without nesting (simplified)
+    static void print_item(Value item)
+    {
+        if (IS_NUMBER(item))
+        {
+            printf("%g", AS_NUMBER(item));
+        }
+        else if (IS_STRING(item))
+        {
+            printf("%s", AS_STRING(item));
+        }
+        else
+        {
+            printf("<object>");
+        }
+    }
+
     // Built-in functions
-    static MASObject *builtin_print(Interpreter *interp, MASObject **args, int arg_count)
+    static Value builtin_print(Interpreter *interp, Value *args, int arg_count)
     {
         (void)interp;
         for (int i = 0; i < arg_count; i++)
         {
             if (i > 0)
                 printf(" ");
-            MASObject *arg = args[i];
-            switch (arg->type)
+            Value arg = args[i];
+            switch (value_type(arg))
             {
             case AST_NUMBER:
-                printf("%g", arg->data.number);
+                printf("%g", AS_NUMBER(arg));
                 break;
             case AST_STRING:
-                printf("%s", arg->data.string);
+                printf("%s", AS_STRING(arg));
                 break;
             case AST_BOOLEAN:
-                printf("%s", arg->data.boolean ? "true" : "false");
+                printf("%s", AS_BOOL(arg) ? "true" : "false");
                 break;
             case AST_NULL:
                 printf("null");
                 break;
             case AST_LIST:
                 printf("[");
-                for (int j = 0; j < arg->data.list.count; j++)
+                for (int j = 0; j < AS_OBJ(arg)->data.list.count; j++)
                 {
                     if (j > 0)
                         printf(", ");
-                    // Recursively print list items (simplified)
-                    MASObject *item = arg->data.list.items[j];
-                    if (item->type == AST_NUMBER)
-                    {
-                        printf("%g", item->data.number);
-                    }
-                    else if (item->type == AST_STRING)
-                    {
-                        printf("%s", item->data.string);
-                    }
-                    else
-                    {
-                        printf("<object>");
-                    }
+                    print_item(AS_OBJ(arg)->data.list.items[j]);
                 }
                 printf("]");
                 break;
+            case AST_RANGE:
+            {
+                MASObject *range = AS_OBJ(arg);
+                printf("range(%d, %d", range->data.range.start, range->data.range.end);
+                if (range->data.range.step != 1)
+                    printf(", %d", range->data.range.step);
+                printf(")");
+                break;
+            }
+            case AST_DICT:
+            {
+                MASObject *dict = AS_OBJ(arg);
+                printf("{");
+                for (int j = dict_next(dict, 0), first = 1; j >= 0; j = dict_next(dict, j + 1), first = 0)
+                {
+                    if (!first)
+                        printf(", ");
+                    print_item(dict->data.dict.entries[j].key);
+                    printf(": ");
+                    print_item(dict->data.dict.entries[j].value);
+                }
+                printf("}");
+                break;
+            }
             default:
                 printf("<object>");
                 break;
             }
         }
         printf("\n");
-        return create_null();
+        return NULL_VAL;
     }
 
-    static MASObject *builtin_gc(Interpreter *interp, MASObject **args, int arg_count) {
+    static Value builtin_gc(Interpreter *interp, Value *args, int arg_count) {
         (void)args; 
         (void)arg_count;
-        gc_collect(interp);
-        return create_null();
+        gc_collect(interp, true);
+        return NULL_VAL;
     }
 
-    // Evaluation functions
-    static MASObject *evaluate_binop(ASTNode *node, Interpreter *interp)
+    // List built-ins. Arguments live on the root stack (or the VM stack), so
+    // they stay valid across allocations; raw object pointers do not.
+    static MASObject *list_arg(Value *args, int arg_count, int min_args, int max_args, const char *name)
     {
-        MASObject *left = evaluate(node->data.binop.left, interp);
-        MASObject *right = evaluate(node->data.binop.right, interp);
+        if (arg_count < min_args || arg_count > max_args) {
+            fprintf(stderr, "%s expects %d to %d arguments, got %d\n", name, min_args, max_args, arg_count);
+            exit(1);
+        }
+        if (!IS_LIST(args[0])) {
+            fprintf(stderr, "%s requires a list\n", name);
+            exit(1);
+        }
+        return AS_OBJ(args[0]);
+    }
 
-        // Only support number operations for now
-        if (left->type != AST_NUMBER || right->type != AST_NUMBER)
-        {
-            fprintf(stderr, "Type error: binary operation requires numbers\n");
+    static int index_arg(Value value, const char *name)
+    {
+        if (!IS_NUMBER(value)) {
+            fprintf(stderr, "%s index must be a number\n", name);
             exit(1);
         }
+        return (int)AS_NUMBER(value);
+    }
 
-        double lval = left->data.number;
-        double rval = right->data.number;
-        if (strcmp(node->data.binop.op, "+") == 0)
-        {
-            return create_number(lval + rval);
+    static Value builtin_append(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *list = list_arg(args, arg_count, 2, 2, "append");
+        gc_reserve_list(list, list->data.list.count + 1);
+        list->data.list.items[list->data.list.count++] = args[1];
+        gc_write_barrier(list, args[1]);
+        return NULL_VAL;
+    }
+
+    static Value builtin_pop(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *list = list_arg(args, arg_count, 1, 2, "pop");
+        int count = list->data.list.count;
+        int idx = arg_count > 1 ? index_arg(args[1], "pop") : count - 1;
+        if (idx < 0) idx += count;
+        if (count == 0) {
+            fprintf(stderr, "pop from empty list\n");
+            exit(1);
         }
-        else if (strcmp(node->data.binop.op, "-") == 0)
-        {
-            return create_number(lval - rval);
+        if (idx < 0 || idx >= count) {
+            fprintf(stderr, "pop index %d out of bounds\n", idx);
+            exit(1);
         }
-        else if (strcmp(node->data.binop.op, "*") == 0)
-        {
-            return create_number(lval * rval);
+        Value item = list->data.list.items[idx];
+        memmove(&list->data.list.items[idx], &list->data.list.items[idx + 1], sizeof(Value) * (count - idx - 1));
+        list->data.list.count--;
+        if (gc_marking) {
+            // An incremental mark may already have scanned the slots the
+            // items moved into
+            for (int i = idx; i < count - 1; i++) {
+                gc_write_barrier(list, list->data.list.items[i]);
+            }
         }
-        else if (strcmp(node->data.binop.op, "/") == 0)
-        {
-            if (rval == 0)
-            {
-                fprintf(stderr, "Division by zero\n");
+        return item;
+    }
+
+    static Value builtin_insert(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *list = list_arg(args, arg_count, 3, 3, "insert");
+        int count = list->data.list.count;
+        int idx = index_arg(args[1], "insert");
+        if (idx < 0) idx += count;
+        if (idx < 0 || idx > count) {
+            fprintf(stderr, "insert index %d out of bounds\n", idx);
+            exit(1);
+        }
+        gc_reserve_list(list, count + 1);
+        memmove(&list->data.list.items[idx + 1], &list->data.list.items[idx], sizeof(Value) * (count - idx));
+        list->data.list.items[idx] = args[2];
+        list->data.list.count++;
+        gc_write_barrier(list, args[2]);
+        return NULL_VAL;
+    }
+
+    static Value builtin_extend(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *list = list_arg(args, arg_count, 2, 2, "extend");
+        if (!IS_LIST(args[1])) {
+            fprintf(stderr, "extend requires a list to add\n");
+            exit(1);
+        }
+        MASObject *other = AS_OBJ(args[1]);
+        int added = other->data.list.count;     // read first: 'other' may be 'list'
+        gc_reserve_list(list, list->data.list.count + added);
+        for (int i = 0; i < added; i++) {
+            Value item = other->data.list.items[i];
+            list->data.list.items[list->data.list.count++] = item;
+            gc_write_barrier(list, item);
+        }
+        return NULL_VAL;
+    }
+
+    static Value builtin_len(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        if (arg_count != 1) {
+            fprintf(stderr, "len expects 1 argument, got %d\n", arg_count);
+            exit(1);
+        }
+        if (IS_LIST(args[0])) {
+            return NUMBER_VAL(AS_OBJ(args[0])->data.list.count);
+        }
+        if (IS_DICT(args[0])) {
+            return NUMBER_VAL(AS_OBJ(args[0])->data.dict.count);
+        }
+        if (IS_RANGE(args[0])) {
+            return NUMBER_VAL(range_length(AS_OBJ(args[0])));
+        }
+        if (IS_STRING(args[0])) {
+            return NUMBER_VAL(strlen(AS_STRING(args[0])));
+        }
+        fprintf(stderr, "len requires a list, a dictionary, a range or a string\n");
+        exit(1);
+    }
+
+    // slice(list, start[, end]): a new list of the items in [start, end).
+    // Negative bounds count from the end; bounds are clamped to the list.
+    static Value builtin_slice(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *list = list_arg(args, arg_count, 2, 3, "slice");
+        int count = list->data.list.count;
+        int start = index_arg(args[1], "slice");
+        int end = arg_count > 2 ? index_arg(args[2], "slice") : count;
+        if (start < 0) start += count;
+        if (end < 0) end += count;
+        if (start < 0) start = 0;
+        if (end > count) end = count;
+        int length = end > start ? end - start : 0;
+
+        // Allocating may move the source list; re-read it from its argument slot
+        MASObject *result = allocate_object(AST_LIST, sizeof(Value) * length);
+        result->data.list.count = length;
+        result->data.list.capacity = length;
+        list = AS_OBJ(args[0]);
+        for (int i = 0; i < length; i++) {
+            result->data.list.items[i] = list->data.list.items[start + i];
+            gc_write_barrier(result, result->data.list.items[i]);
+        }
+        return OBJ_VAL(result);
+    }
+
+    // range(start, end[, step]): start, start + step, ... up to and including
+    // end, like 'each i in start to end'. Bounds are truncated to integers.
+    static Value builtin_range(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        if (arg_count < 2 || arg_count > 3) {
+            fprintf(stderr, "range expects 2 to 3 arguments, got %d\n", arg_count);
+            exit(1);
+        }
+        for (int i = 0; i < arg_count; i++) {
+            if (!IS_NUMBER(args[i])) {
+                fprintf(stderr, "Range bounds must be numbers\n");
                 exit(1);
             }
-            return create_number(lval / rval);
         }
-        else if (strcmp(node->data.binop.op, "==") == 0)
-        {
-            return create_boolean(lval == rval);
+        int step = arg_count > 2 ? (int)AS_NUMBER(args[2]) : 1;
+        if (step == 0) {
+            fprintf(stderr, "range step must not be 0\n");
+            exit(1);
         }
-        else if (strcmp(node->data.binop.op, "!=") == 0)
-        {
-            return create_boolean(lval != rval);
+        return create_range((int)AS_NUMBER(args[0]), (int)AS_NUMBER(args[1]), step);
+    }
+
+    // Dictionary built-ins
+    static MASObject *dict_arg(Value *args, int arg_count, int min_args, int max_args, const char *name)
+    {
+        if (arg_count < min_args || arg_count > max_args) {
+            fprintf(stderr, "%s expects %d to %d arguments, got %d\n", name, min_args, max_args, arg_count);
+            exit(1);
         }
-        else if (strcmp(node->data.binop.op, "<") == 0)
-        {
-            return create_boolean(lval < rval);
+        if (!IS_DICT(args[0])) {
+            fprintf(stderr, "%s requires a dictionary\n", name);
+            exit(1);
         }
-        else if (strcmp(node->data.binop.op, "<=") == 0)
-        {
-            return create_boolean(lval <= rval);
+        return AS_OBJ(args[0]);
+    }
+
+    static Value builtin_has(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *dict = dict_arg(args, arg_count, 2, 2, "has");
+        Value value;
+        dict_check_key(args[1]);
+        return BOOL_VAL(dict_get(dict, args[1], &value));
+    }
+
+    // get(dict, key[, default]): the value for key, or default (null)
+    static Value builtin_get(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *dict = dict_arg(args, arg_count, 2, 3, "get");
+        Value value;
+        dict_check_key(args[1]);
+        if (dict_get(dict, args[1], &value)) return value;
+        return arg_count > 2 ? args[2] : NULL_VAL;
+    }
+
+    static Value builtin_delete(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *dict = dict_arg(args, arg_count, 2, 2, "delete");
+        dict_check_key(args[1]);
+        return BOOL_VAL(dict_delete(dict, args[1]));
+    }
+
+    static Value builtin_keys(Interpreter *interp, Value *args, int arg_count)
+    {
+        (void)interp;
+        MASObject *dict = dict_arg(args, arg_count, 1, 1, "keys");
+        int count = dict->data.dict.count;
+
+        // Allocating may move the dictionary; re-read it from its argument slot
+        MASObject *result = allocate_object(AST_LIST, sizeof(Value) * count);
+        result->data.list.count = count;
+        result->data.list.capacity = count;
+        dict = AS_OBJ(args[0]);
+        int n = 0;
+        for (int i = dict_next(dict, 0); i >= 0; i = dict_next(dict, i + 1)) {
+            result->data.list.items[n++] = dict->data.dict.entries[i].key;
+            gc_write_barrier(result, dict->data.dict.entries[i].key);
+        }
+        return OBJ_VAL(result);
+    }
+
+    const Builtin builtins[] = {
+        {"print", builtin_print},
+        {"input", builtin_input},
+        {"input_num", builtin_input_num},
+        {"gc", builtin_gc},
+        {"append", builtin_append},
+        {"pop", builtin_pop},
+        {"insert", builtin_insert},
+        {"extend", builtin_extend},
+        {"len", builtin_len},
+        {"slice", builtin_slice},
+        {"has", builtin_has},
+        {"get", builtin_get},
+        {"delete", builtin_delete},
+        {"keys", builtin_keys},
+        {"range", builtin_range},
+        {NULL, NULL}
+    };
+
+    // Builtins are registered by interned name on first use
+    int find_builtin(Atom name)
+    {
+        static AtomMap names;
+        if (names.count == 0) {
+            for (int i = 0; builtins[i].name; i++) {
+                atom_map_set(&names, atom_intern(builtins[i].name), i);
+            }
         }
-        else if (strcmp(node->data.binop.op, ">") == 0)
+        return atom_map_get(&names, name);
+    }
+
+    // Evaluation functions
+    // Operands a quickened binop reads without going through evaluate
+    static bool is_direct_operand(ASTNode *node)
+    {
+        return node->type == AST_VAR || node->type == AST_NUMBER;
+    }
+
+    static Value direct_operand(ASTNode *node, Interpreter *interp)
+    {
+        if (node->type == AST_NUMBER)
+            return NUMBER_VAL(node->data.number);
+        return *variable_slot(interp, node->data.var.slot, node->data.var.global);
+    }
+
+    // Pick the form a binop keeps after its first run
+    static void quicken_binop(ASTNode *node, Value left, Value right)
+    {
+        node->data.binop.quick = QUICK_GENERIC;
+        if (IS_NUMBER(left) && IS_NUMBER(right) &&
+            is_direct_operand(node->data.binop.left) && is_direct_operand(node->data.binop.right))
         {
-            return create_boolean(lval > rval);
+            node->data.binop.quick = QUICK_DIRECT;
+            if (options.quicken_stats)
+            {
+                node->data.binop.site = quick_site_new(node->line, node->data.binop.op);
+                node->data.binop.site->form = "slots";
+            }
         }
-        else if (strcmp(node->data.binop.op, ">=") == 0)
+    }
+
+    static Value evaluate_binop(ASTNode *node, Interpreter *interp)
+    {
+        Value left, right;
+        if (node->data.binop.quick == QUICK_DIRECT)
         {
-            return create_boolean(lval >= rval);
+            QuickSite *site = node->data.binop.site;
+            left = direct_operand(node->data.binop.left, interp);
+            right = direct_operand(node->data.binop.right, interp);
+            if (IS_NUMBER(left) && IS_NUMBER(right))
+            {
+                if (site)
+                    site->hits++;
+            }
+            else
+            {
+                if (site)
+                    site->misses++;
+                node->data.binop.quick = QUICK_GENERIC;
+            }
         }
         else
         {
-            fprintf(stderr, "Unknown operator: %s\n", node->data.binop.op);
+            left = evaluate(node->data.binop.left, interp);
+            push_root(interp, left);
+            right = evaluate(node->data.binop.right, interp);
+            pop_roots(interp, 1);
+            if (node->data.binop.quick == QUICK_NONE)
+                quicken_binop(node, left, right);
+        }
+
+        // Only support number operations for now
+        if (!IS_NUMBER(left) || !IS_NUMBER(right))
+        {
+            fprintf(stderr, "Type error: binary operation requires numbers\n");
             exit(1);
         }
+
+        double lval = AS_NUMBER(left);
+        double rval = AS_NUMBER(right);
+        switch (node->data.binop.op)
+        {
+        case BINOP_ADD:
+            return NUMBER_VAL(lval + rval);
+        case BINOP_SUB:
+            return NUMBER_VAL(lval - rval);
+        case BINOP_MUL:
+            return NUMBER_VAL(lval * rval);
+        case BINOP_DIV:
+            if (rval == 0)
+            {
+                fprintf(stderr, "Division by zero\n");
+                exit(1);
+            }
+            return NUMBER_VAL(lval / rval);
+        case BINOP_EQ:
+            return BOOL_VAL(lval == rval);
+        case BINOP_NEQ:
+            return BOOL_VAL(lval != rval);
+        case BINOP_LT:
+            return BOOL_VAL(lval < rval);
+        case BINOP_LE:
+            return BOOL_VAL(lval <= rval);
+        case BINOP_GT:
+            return BOOL_VAL(lval > rval);
+        case BINOP_GE:
+            return BOOL_VAL(lval >= rval);
+        }
+        fprintf(stderr, "Unknown operator: %d\n", node->data.binop.op);
+        exit(1);
     }
 
-    static MASObject *evaluate(ASTNode *node, Interpreter *interp)
+    static Value evaluate(ASTNode *node, Interpreter *interp)
     {
         switch (node->type)
         {
         case AST_PROGRAM:
-        {
-            MASObject *last = create_null();
-            for (int i = 0; i < node->data.list.count; i++)
-            {
-                last = evaluate(node->data.list.items[i], interp);
-            }
-            return last;
-        }
+            execute_block(node->data.list.items, node->data.list.count, interp);
+            return NULL_VAL;
         case AST_NUMBER:
-            return create_number(node->data.number);
+            return NUMBER_VAL(node->data.number);
         case AST_STRING:
             return create_string(node->data.string);
         case AST_BOOLEAN:
-            return create_boolean(node->data.boolean);
+            return BOOL_VAL(node->data.boolean);
         case AST_NULL:
-            return create_null();
+            return NULL_VAL;
         case AST_VAR:
         {
-            MASObject *value = symbol_table_get(interp->locals, node->data.var_name);
-            if (!value)
-            {
-                value = symbol_table_get(interp->globals, node->data.var_name);
-            }
-            if (!value)
-            {
-                return create_number(0.0);
-            }
-            return value;
+            // Unassigned slots hold 0 (all bits clear), which reads as the number 0
+            return *variable_slot(interp, node->data.var.slot, node->data.var.global);
         }
         case AST_ASSIGN:
         {
-            MASObject *value = evaluate(node->data.assign.value, interp);
+            Value value = evaluate(node->data.assign.value, interp);
 
             if (node->data.assign.index == NULL) {
                 // Plain variable assignment
-                symbol_table_set(interp->locals, node->data.assign.name, value);
+                *variable_slot(interp, node->data.assign.slot, node->data.assign.global) = value;
             } else {
                 // Indexed assignment: a[i] = value
 
-                // 1. Find the list variable
-                MASObject *list_obj = symbol_table_get(interp->locals, node->data.assign.name);
-                if (!list_obj) {
-                    list_obj = symbol_table_get(interp->globals, node->data.assign.name);
-                }
-                if (!list_obj || list_obj->type != AST_LIST) {
-                    fprintf(stderr, "Error: '%s' is not a list\n", node->data.assign.name);
+                // 1. Find the list (or dictionary) variable
+                Value list_val = *variable_slot(interp, node->data.assign.slot, node->data.assign.global);
+                if (!IS_LIST(list_val) && !IS_DICT(list_val)) {
+                    fprintf(stderr, "Error: '%s' is not a list or dictionary\n", node->data.assign.name);
                     exit(1);
                 }
 
-                // 2. Evaluate index
-                MASObject *index_obj = evaluate(node->data.assign.index, interp);
-                if (index_obj->type != AST_NUMBER) {
+                // 2. Evaluate index (a collection may move the value and the list)
+                int root = push_root(interp, value);
+                push_root(interp, list_val);
+                Value index_val = evaluate(node->data.assign.index, interp);
+                pop_roots(interp, 2);
+                value = interp->roots[root];
+                MASObject *list_obj = AS_OBJ(interp->roots[root + 1]);
+                if (list_obj->type == AST_DICT) {
+                    dict_check_key(index_val);
+                    dict_set(list_obj, index_val, value);
+                    return value;
+                }
+                if (!IS_NUMBER(index_val)) {
                     fprintf(stderr, "List index must be a number\n");
                     exit(1);
                 }
-                int idx = (int)index_obj->data.number;
+                int idx = (int)AS_NUMBER(index_val);
 
                 // 3. Bounds check
                 if (idx < 0 || idx >= list_obj->data.list.count) {
@@ -461,6 +716,7 @@ static MASObject *builtin_input_num(Interpreter *interp, MASObject **args, int a
                 // 4. Assign (replace item)
                 // In pure GC, just overwrite — old item may become unreachable
                 list_obj->data.list.items[idx] = value;
+                gc_write_barrier(list_obj, value);
             }
             return value;
         }
@@ -468,303 +724,421 @@ static MASObject *builtin_input_num(Interpreter *interp, MASObject **args, int a
             return evaluate_binop(node, interp);
         case AST_UNARYOP:
         {
-            MASObject *operand = evaluate(node->data.unaryop.operand, interp);
-            if (operand->type != AST_NUMBER)
+            Value operand = evaluate(node->data.unaryop.operand, interp);
+            if (!IS_NUMBER(operand))
             {
                 fprintf(stderr, "Unary minus requires a number\n");
                 exit(1);
             }
-            MASObject *result = create_number(-operand->data.number);
-            return result;
+            return NUMBER_VAL(-AS_NUMBER(operand));
         }
         case AST_LIST:
         {
-            MASObject **items = malloc(sizeof(MASObject *) * node->data.list.count);
+            // Items are collected on the root stack until the list owns them
+            int base = interp->root_count;
             for (int i = 0; i < node->data.list.count; i++)
             {
-                items[i] = evaluate(node->data.list.items[i], interp);
+                Value item = evaluate(node->data.list.items[i], interp);
+                push_root(interp, item);
             }
-            MASObject *list = create_list(items, node->data.list.count);
-            free(items);
+            Value list = create_list(interp->roots + base, node->data.list.count);
+            pop_roots(interp, node->data.list.count);
             return list;
         }
-        case AST_CALL: {
-        // Check built-ins first
-        if (strcmp(node->data.call.name, "print") == 0) {
-            MASObject** args = malloc(sizeof(MASObject*) * node->data.call.arg_count);
-            for (int i = 0; i < node->data.call.arg_count; i++) {
-                args[i] = evaluate(node->data.call.args[i], interp);
+        case AST_DICT:
+        {
+            // Keys and values are collected on the root stack first
+            int base = interp->root_count;
+            for (int i = 0; i < node->data.dict.count; i++)
+            {
+                Value key = evaluate(node->data.dict.keys[i], interp);
+                push_root(interp, key);
+                dict_check_key(key);
+                Value value = evaluate(node->data.dict.values[i], interp);
+                push_root(interp, value);
             }
-            MASObject* result = builtin_print(interp, args, node->data.call.arg_count);
-            free(args);
-            return result;
-        }
-        else if (strcmp(node->data.call.name, "input") == 0) {
-            MASObject** args = malloc(sizeof(MASObject*) * node->data.call.arg_count);
-            for (int i = 0; i < node->data.call.arg_count; i++) {
-                args[i] = evaluate(node->data.call.args[i], interp);
+            Value dict = create_dict(node->data.dict.count);
+            for (int i = 0; i < node->data.dict.count; i++)
+            {
+                dict_set(AS_OBJ(dict), interp->roots[base + 2 * i], interp->roots[base + 2 * i + 1]);
             }
-            MASObject* result = builtin_input(interp, args, node->data.call.arg_count);
-            free(args);
-            return result;
+            pop_roots(interp, 2 * node->data.dict.count);
+            return dict;
         }
-        else if (strcmp(node->data.call.name, "input_num") == 0) {
-            MASObject** args = malloc(sizeof(MASObject*) * node->data.call.arg_count);
+        case AST_CALL: {
+        // Built-ins are bound by the resolver and take precedence
+        int builtin = node->data.call.builtin;
+        if (builtin >= 0) {
+            int base = interp->root_count;
             for (int i = 0; i < node->data.call.arg_count; i++) {
-                args[i] = evaluate(node->data.call.args[i], interp);
+                Value arg = evaluate(node->data.call.args[i], interp);
+                push_root(interp, arg);
             }
-            MASObject* result = builtin_input_num(interp, args, node->data.call.arg_count);
-            free(args);
+            Value result = builtins[builtin].fn(interp, interp->roots + base, node->data.call.arg_count);
+            pop_roots(interp, node->data.call.arg_count);
             return result;
         }
-        else if (strcmp(node->data.call.name, "gc") == 0) {
-            for (int i = 0; i < node->data.call.arg_count; i++) {
-                MASObject* arg = evaluate(node->data.call.args[i], interp);
-            }
-            return builtin_gc(interp, NULL, 0);
-        }
 
-        // Look up user-defined function
-        ASTNode* func = NULL;
-        for (int i = 0; i < interp->functions.count; i++) {
-            if (strcmp(interp->functions.names[i], node->data.call.name) == 0) {
-                func = interp->functions.funcs[i];
-                break;
-            }
-        }
+        ASTNode* func = node->data.call.function;
+        if (!func)
+            func = bind_call(node, interp);
 
-        if (!func) {
-            fprintf(stderr, "Function not defined: %s\n", node->data.call.name);
-            exit(1);
-        }
-
-        // Evaluate arguments
-        MASObject** arg_values = malloc(sizeof(MASObject*) * node->data.call.arg_count);
+        // The callee's slots are reserved first and the arguments evaluated
+        // straight into its parameters; calls made by the arguments stack
+        // their frames above it
+        int base = push_frame(interp, func->data.funcdef.local_count);
         for (int i = 0; i < node->data.call.arg_count; i++) {
-            arg_values[i] = evaluate(node->data.call.args[i], interp);
+            Value arg = evaluate(node->data.call.args[i], interp);
+            interp->frames[base + i] = arg;
         }
-
-        // Save current locals (for recursion/nesting)
-        SymbolTable* old_locals = interp->locals;
-        interp->locals = create_symbol_table();
-
-        // Bind parameters
-        if (node->data.call.arg_count != func->data.funcdef.param_count) {
-            fprintf(stderr, "Function %s expects %d arguments, got %d\n",
-                    node->data.call.name, func->data.funcdef.param_count, node->data.call.arg_count);
-            exit(1);
+        int caller_base = interp->frame_base;
+        interp->frame_base = base;
+        interp->locals = interp->frames + base;
+
+        // Execute function body; loops of the caller do not enclose it
+        int caller_loops = interp->loop_depth;
+        interp->loop_depth = 0;
+        interp->call_depth++;
+        Flow flow;
+        while ((flow = execute_block(func->data.funcdef.body, func->data.funcdef.body_count, interp)) == FLOW_TAIL_CALL)
+        {
+            func = interp->tail_function;
         }
+        Value return_value = flow == FLOW_RETURN ? interp->return_value : NULL_VAL;
+        interp->call_depth--;
+        interp->loop_depth = caller_loops;
 
-        for (int i = 0; i < func->data.funcdef.param_count; i++) {
-            symbol_table_set(interp->locals, func->data.funcdef.params[i], arg_values[i]);
-        }
+        interp->frame_top = base;
+        interp->frame_base = caller_base;
+        interp->locals = interp->frames + caller_base;
 
-        // Execute function body
-        MASObject* return_value = create_null();
-        // bool has_returned = false;
+        return return_value;
+    }
+        case AST_INDEX:
+        {
+            // Look up the list (or dictionary) variable
+            Value list_val = *variable_slot(interp, node->data.index.slot, node->data.index.global);
+            if (!IS_LIST(list_val) && !IS_DICT(list_val)) {
+                fprintf(stderr, "Error: '%s' is not a list or dictionary (line %d)\n", 
+                        node->data.index.target, node->line);
+                exit(1);
+            }
 
-        for (int i = 0; i < func->data.funcdef.body_count; i++) {
-            ASTNode* stmt = func->data.funcdef.body[i];
-            MASObject* result = evaluate(stmt, interp);
-            
-            // Handle 'give' (return)
-            if (stmt->type == AST_RETURN) {
-                return_value = result;
-                // has_returned = true;
-                break;
+            // Evaluate index expression
+            int root = push_root(interp, list_val);
+            Value index_val = evaluate(node->data.index.index, interp);
+            pop_roots(interp, 1);
+            MASObject *list_obj = AS_OBJ(interp->roots[root]);
+            if (list_obj->type == AST_DICT) {
+                // Missing keys read as null
+                Value value = NULL_VAL;
+                dict_check_key(index_val);
+                dict_get(list_obj, index_val, &value);
+                return value;
             }
-        }
+            if (!IS_NUMBER(index_val)) {
+                fprintf(stderr, "List index must be a number (line %d)\n", node->line);
+                exit(1);
+            }
+            int idx = (int)AS_NUMBER(index_val);
 
-        SymbolTable* temp = interp->locals;
-        interp->locals = old_locals;
-        for (int i = 0; i < temp->count; i++) {
-            free(temp->names[i]);          // free variable name (strdup'd)
+            // Bounds check
+            if (idx < 0 || idx >= list_obj->data.list.count) {
+                fprintf(stderr, "Index %d out of bounds (line %d)\n", idx, node->line);
+                exit(1);
+            }
+
+            // Return the item (no incref — GC handles it)
+            return list_obj->data.list.items[idx];
         }
-        free(temp->names);
-        free(temp->values);
-        free(temp);
+        default:
+            fprintf(stderr, "Unknown AST node type: %d\n", node->type);
+            exit(1);
+        }
+    }
+    // Statements
+    static Flow execute_block(ASTNode **body, int count, Interpreter *interp)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            Flow flow = execute(body[i], interp);
+            if (flow != FLOW_NORMAL)
+                return flow;
+        }
+        return FLOW_NORMAL;
+    }
 
-        free(arg_values);
-        return return_value;
+    // One iteration of a loop body. The caller ends the loop on FLOW_BREAK
+    // and returns when leaves_call(); FLOW_CONTINUE just ends the iteration.
+    static Flow execute_loop_body(ASTNode **body, int count, Interpreter *interp)
+    {
+        interp->loop_depth++;
+        Flow flow = execute_block(body, count, interp);
+        interp->loop_depth--;
+        return flow;
     }
-    case AST_LOOP:
+
+    static Flow execute(ASTNode *node, Interpreter *interp)
+    {
+        switch (node->type)
+        {
+        case AST_LOOP:
         {
             while (1)
             {
-                MASObject *cond = evaluate(node->data.loop.condition, interp);
-                if (cond->type != AST_BOOLEAN)
+                Value cond = evaluate(node->data.loop.condition, interp);
+                if (!IS_BOOL(cond))
                 {
                     fprintf(stderr, "Loop condition must be boolean\n");
                     exit(1);
                 }
-                if (!cond->data.boolean)
+                if (!AS_BOOL(cond))
                 {
                     break;
                 }
 
-                // Execute loop body
-                for (int i = 0; i < node->data.loop.body_count; i++)
-                {
-                    evaluate(node->data.loop.body[i], interp);
-                }
+                Flow flow = execute_loop_body(node->data.loop.body, node->data.loop.body_count, interp);
+                if (flow == FLOW_BREAK)
+                    break;
+                if (leaves_call(flow))
+                    return flow;
             }
-            return create_null();
+            return FLOW_NORMAL;
         }
         case AST_EACH:
         {
             if (node->data.each.range_start)
             {
                 // Range-based loop: each i in start to end
-                MASObject *start_val = evaluate(node->data.each.range_start, interp);
-                MASObject *end_val = evaluate(node->data.each.range_end, interp);
+                Value start_val = evaluate(node->data.each.range_start, interp);
+                Value end_val = evaluate(node->data.each.range_end, interp);
 
-                if (start_val->type != AST_NUMBER || end_val->type != AST_NUMBER)
+                if (!IS_NUMBER(start_val) || !IS_NUMBER(end_val))
                 {
                     fprintf(stderr, "Range bounds must be numbers\n");
                     exit(1);
                 }
 
-                int start = (int)start_val->data.number;
-                int end = (int)end_val->data.number;
+                int start = (int)AS_NUMBER(start_val);
+                int end = (int)AS_NUMBER(end_val);
 
                 // Loop from start to end (inclusive)
                 for (int i = start; i <= end; i++)
                 {
-                    MASObject *num = create_number(i);
-                    symbol_table_set(interp->locals, node->data.each.target, num);
-
-                    // Execute body
-                    for (int j = 0; j < node->data.each.body_count; j++)
-                    {
-                        evaluate(node->data.each.body[j], interp);
-                    }
+                    *variable_slot(interp, node->data.each.slot, node->data.each.global) = NUMBER_VAL(i);
+
+                    Flow flow = execute_loop_body(node->data.each.body, node->data.each.body_count, interp);
+                    if (flow == FLOW_BREAK)
+                        break;
+                    if (leaves_call(flow))
+                        return flow;
                 }
+                return FLOW_NORMAL;
             }
-            else
+
+            // Original list-based each
+            Value iterable_val = evaluate(node->data.each.iterable, interp);
+            if (IS_RANGE(iterable_val))
             {
-                // Original list-based each
-                MASObject *iterable = evaluate(node->data.each.iterable, interp);
-                if (iterable->type != AST_LIST)
+                // The bounds are copied out, so nothing needs to stay rooted
+                MASObject *range = AS_OBJ(iterable_val);
+                double start = range->data.range.start;
+                double step = range->data.range.step;
+                int count = range_length(range);
+                for (int i = 0; i < count; i++)
                 {
-                    fprintf(stderr, "Each requires a list\n");
-                    exit(1);
+                    *variable_slot(interp, node->data.each.slot, node->data.each.global) = NUMBER_VAL(start + i * step);
+
+                    Flow flow = execute_loop_body(node->data.each.body, node->data.each.body_count, interp);
+                    if (flow == FLOW_BREAK)
+                        break;
+                    if (leaves_call(flow))
+                        return flow;
                 }
+                return FLOW_NORMAL;
+            }
+            if (!IS_LIST(iterable_val) && !IS_DICT(iterable_val))
+            {
+                fprintf(stderr, "Each requires a list, dictionary or range\n");
+                exit(1);
+            }
+            // The body may move the list, so it is re-read from its root
+            int root = push_root(interp, iterable_val);
+            Flow flow = FLOW_NORMAL;
 
-                for (int i = 0; i < iterable->data.list.count; i++)
+            if (IS_DICT(iterable_val))
+            {
+                // Iterating a dictionary binds its keys
+                for (int i = dict_next(AS_OBJ(interp->roots[root]), 0); i >= 0;
+                     i = dict_next(AS_OBJ(interp->roots[root]), i + 1))
+                {
+                    MASObject *dict = AS_OBJ(interp->roots[root]);
+                    *variable_slot(interp, node->data.each.slot, node->data.each.global) = dict->data.dict.entries[i].key;
+
+                    flow = execute_loop_body(node->data.each.body, node->data.each.body_count, interp);
+                    if (flow == FLOW_BREAK || leaves_call(flow))
+                        break;
+                }
+            }
+            else
+            {
+                for (int i = 0; i < AS_OBJ(interp->roots[root])->data.list.count; i++)
                 {
-                    symbol_table_set(interp->locals, node->data.each.target, iterable->data.list.items[i]);
+                    MASObject *iterable = AS_OBJ(interp->roots[root]);
+                    *variable_slot(interp, node->data.each.slot, node->data.each.global) = iterable->data.list.items[i];
 
-                    for (int j = 0; j < node->data.each.body_count; j++)
-                    {
-                        evaluate(node->data.each.body[j], interp);
-                    }
+                    flow = execute_loop_body(node->data.each.body, node->data.each.body_count, interp);
+                    if (flow == FLOW_BREAK || leaves_call(flow))
+                        break;
                 }
             }
-            return create_null();
+            pop_roots(interp, 1);
+            return leaves_call(flow) ? flow : FLOW_NORMAL;
         }
         case AST_IF:
         {
-            MASObject *cond = evaluate(node->data.if_stmt.condition, interp);
-            if (cond->type != AST_BOOLEAN)
+            Value cond = evaluate(node->data.if_stmt.condition, interp);
+            if (!IS_BOOL(cond))
             {
                 fprintf(stderr, "If condition must be boolean\n");
                 exit(1);
             }
 
-            if (cond->data.boolean)
+            if (AS_BOOL(cond))
             {
-                // Execute 'then' branch
-                for (int i = 0; i < node->data.if_stmt.then_body_count; i++)
-                {
-                    evaluate(node->data.if_stmt.then_body[i], interp);
-                }
+                return execute_block(node->data.if_stmt.then_body, node->data.if_stmt.then_body_count, interp);
             }
             else if (node->data.if_stmt.else_body)
             {
-                // Execute 'else' branch (only if it exists)
-                for (int i = 0; i < node->data.if_stmt.else_body_count; i++)
-                {
-                    evaluate(node->data.if_stmt.else_body[i], interp);
-                }
+                return execute_block(node->data.if_stmt.else_body, node->data.if_stmt.else_body_count, interp);
             }
-
-            return create_null();
+            return FLOW_NORMAL;
         }
         case AST_EXPRSTMT:
-        {
             evaluate(node->data.expr, interp);
-            return create_null();
-        }
+            return FLOW_NORMAL;
         case AST_BREAK:
+            // 'stop' and 'next' outside of a loop do nothing
+            return interp->loop_depth > 0 ? FLOW_BREAK : FLOW_NORMAL;
         case AST_CONTINUE:
-            return create_null();
+            return interp->loop_depth > 0 ? FLOW_CONTINUE : FLOW_NORMAL;
         case AST_RETURN:
-            return evaluate(node->data.expr, interp);
-        case AST_FUNCDEF:
-            interpreter_add_function(interp, node->data.funcdef.name, node);
-            return create_null();
-        case AST_INDEX:
         {
-            // Look up the list variable
-            MASObject *list_obj = symbol_table_get(interp->locals, node->data.index.target);
-            if (!list_obj) {
-                list_obj = symbol_table_get(interp->globals, node->data.index.target);
-            }
-            if (!list_obj || list_obj->type != AST_LIST) {
-                fprintf(stderr, "Error: '%s' is not a list (line %d)\n", 
-                        node->data.index.target, node->line);
-                exit(1);
-            }
-
-            // Evaluate index expression
-            MASObject *index_obj = evaluate(node->data.index.index, interp);
-            if (index_obj->type != AST_NUMBER) {
-                fprintf(stderr, "List index must be a number (line %d)\n", node->line);
-                exit(1);
-            }
-            int idx = (int)index_obj->data.number;
-
-            // Bounds check
-            if (idx < 0 || idx >= list_obj->data.list.count) {
-                fprintf(stderr, "Index %d out of bounds (line %d)\n", idx, node->line);
-                exit(1);
+            ASTNode *expr = node->data.expr;
+            if (expr->type == AST_CALL && expr->data.call.tail)
+            {
+                // The arguments are evaluated above the running frame, then
+                // slid down over it; the call loop in evaluate runs the callee
+                // in the same frame and C stack
+                ASTNode *func = expr->data.call.function;
+                if (!func)
+                    func = bind_call(expr, interp);
+                int argc = expr->data.call.arg_count;
+                int local_count = func->data.funcdef.local_count;
+                int args = push_frame(interp, local_count);
+                for (int i = 0; i < argc; i++)
+                {
+                    Value arg = evaluate(expr->data.call.args[i], interp);
+                    interp->frames[args + i] = arg;
+                }
+                Value *frame = interp->frames + interp->frame_base;
+                memmove(frame, interp->frames + args, sizeof(Value) * argc);
+                memset(frame + argc, 0, sizeof(Value) * (local_count - argc));
+                interp->frame_top = interp->frame_base + local_count;
+                interp->tail_function = func;
+                return FLOW_TAIL_CALL;
             }
 
-            // Return the item (no incref — GC handles it)
-            return list_obj->data.list.items[idx];
+            Value value = evaluate(expr, interp);
+            // 'give' at the top level just evaluates its value
+            if (interp->call_depth == 0)
+                return FLOW_NORMAL;
+            interp->return_value = value;
+            return FLOW_RETURN;
         }
+        case AST_FUNCDEF:
+            interpreter_add_function(interp, node->data.funcdef.name, node);
+            return FLOW_NORMAL;
         default:
-            fprintf(stderr, "Unknown AST node type: %d\n", node->type);
-            exit(1);
+            evaluate(node, interp);
+            return FLOW_NORMAL;
         }
     }
-    void interpreter_add_function(Interpreter* interp, const char* name, ASTNode* func) {
+
+    // The first definition of a name is the one calls find
+    void interpreter_add_function(Interpreter* interp, Atom name, ASTNode* func) {
+        if (atom_map_get(&interp->functions.names, name) >= 0) return;
         if (interp->functions.count >= interp->functions.capacity) {
             interp->functions.capacity *= 2;
-            interp->functions.names = realloc(interp->functions.names, 
-                                            sizeof(char*) * interp->functions.capacity);
             interp->functions.funcs = realloc(interp->functions.funcs, 
                                             sizeof(ASTNode*) * interp->functions.capacity);
         }
-        interp->functions.names[interp->functions.count] = strdup(name);
+        atom_map_set(&interp->functions.names, name, interp->functions.count);
         interp->functions.funcs[interp->functions.count] = func;
         interp->functions.count++;
     }
-    MASObject *interpret(ASTNode *ast)
+    // Globals the resolver handed out after the program started running
+    // (with --stream, to statements parsed since) start out as 0
+    void interpreter_reserve_globals(Interpreter *interp)
     {
-        Interpreter interp;
-        interp.globals = create_symbol_table();
-        interp.locals = create_symbol_table();
+        int count = resolver_global_count();
+        if (count <= interp->global_count)
+            return;
+        interp->globals = realloc(interp->globals, sizeof(Value) * count);
+        memset(interp->globals + interp->global_count, 0, sizeof(Value) * (count - interp->global_count));
+        interp->global_count = count;
+    }
+
+    // The parts of a program (one per top-level statement with --stream)
+    // run one after another on this interpreter, sharing globals and
+    // functions
+    static Interpreter session;
 
-        interp.functions.capacity = 16;
-        interp.functions.count = 0;
-        interp.functions.names = malloc(sizeof(char*) * interp.functions.capacity);
-        interp.functions.funcs = malloc(sizeof(ASTNode*) * interp.functions.capacity);
+    void interpret_begin(void)
+    {
+        session.global_count = 0;
+        session.globals = NULL;
+        session.locals = NULL;
+        session.frames = NULL;
+        session.frame_base = 0;
+        session.frame_top = 0;
+        session.frame_capacity = 0;
+        session.return_value = NULL_VAL;
+        session.tail_function = NULL;
+        session.loop_depth = 0;
+        session.call_depth = 0;
+        session.roots = NULL;
+        session.root_count = 0;
+        session.root_capacity = 0;
+
+        session.functions.capacity = 16;
+        session.functions.count = 0;
+        session.functions.names = (AtomMap){0};
+        session.functions.funcs = malloc(sizeof(ASTNode*) * session.functions.capacity);
+        session.vm = NULL;
+        gc_set_interpreter(&session);
+    }
 
-        MASObject *result = evaluate(ast, &interp);
+    Value interpret_next(ASTNode *program)
+    {
+        interpreter_reserve_globals(&session);
+        return evaluate(program, &session);
+    }
 
-        // Cleanup
-        // TODO: Proper cleanup of symbol tables
+    void interpret_end(void)
+    {
+        gc_set_interpreter(NULL);
+        free(session.globals);
+        free(session.roots);
+        free(session.frames);
+        atom_map_free(&session.functions.names);
+        free(session.functions.funcs);
+    }
 
+    Value interpret(ASTNode *ast)
+    {
+        interpret_begin();
+        Value result = interpret_next(ast);
+        interpret_end();
         return result;
     }
\ No newline at end of file
@@ -0,0 +1,466 @@
+// jit.c
+#include "mas.h"
+
+// Baseline template JIT for the VM (x86-64 Linux only). A chunk that has
+// been entered --jit-threshold times is translated instruction by
+// instruction into machine code. The operand stack, locals and globals stay
+// in memory exactly where the interpreter keeps them, so native code can be
+// entered at any instruction and can hand control back at any instruction:
+//   - number arithmetic, comparisons, negation, local and global access,
+//     jumps and 'each ... to' counters run natively
+//   - any other instruction exits to the interpreter, which runs it and
+//     re-enters native code at the next loop back edge, call or return
+//   - an operand that is not a number (or a division by zero) deoptimizes:
+//     the instruction is left undone and the interpreter runs it instead
+// Registers while native code runs: rbx = JitState, r12 = stack top,
+// r13 = locals, r14 = globals, r15 = QNAN for the number guards.
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+typedef struct {
+    Value* sp;                 // offset 0
+    Value* slots;              // offset 8
+    Value* globals;            // offset 16
+    int exit;                  // offset 24: instruction to resume interpreting at
+} JitState;
+
+typedef void (*JitEntry)(JitState* state, void* start);
+
+struct JitCode {
+    uint8_t* code;
+    size_t size;
+    int* labels;               // native offset of each instruction
+};
+
+typedef struct {
+    int at;                    // position of a rel32 operand
+    int target;                // instruction it jumps to
+} Fixup;
+
+typedef struct {
+    uint8_t* bytes;
+    int count;
+    int capacity;
+    int* labels;
+    int epilogue;
+    Fixup* jumps;              // to the native code of an instruction
+    int jump_count;
+    int jump_capacity;
+    Fixup* exits;              // to an exit stub for an instruction
+    int exit_count;
+    int exit_capacity;
+} Assembler;
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Condition codes for jcc and setcc
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_P = 0xA, CC_NP = 0xB };
+
+static void byte(Assembler* a, uint8_t b) {
+    if (a->count >= a->capacity) {
+        a->capacity = a->capacity ? a->capacity * 2 : 4096;
+        a->bytes = realloc(a->bytes, a->capacity);
+    }
+    a->bytes[a->count++] = b;
+}
+
+static void bytes(Assembler* a, const char* data, int count) {
+    for (int i = 0; i < count; i++) byte(a, (uint8_t)data[i]);
+}
+
+static void u32(Assembler* a, uint32_t value) {
+    for (int i = 0; i < 4; i++) byte(a, (uint8_t)(value >> (8 * i)));
+}
+
+static void u64(Assembler* a, uint64_t value) {
+    for (int i = 0; i < 8; i++) byte(a, (uint8_t)(value >> (8 * i)));
+}
+
+static void patch32(Assembler* a, int at, int target) {
+    uint32_t rel = (uint32_t)(target - (at + 4));
+    memcpy(a->bytes + at, &rel, 4);
+}
+
+static void add_fixup(Fixup** list, int* count, int* capacity, int at, int target) {
+    if (*count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *list = realloc(*list, sizeof(Fixup) * *capacity);
+    }
+    (*list)[(*count)++] = (Fixup){at, target};
+}
+
+// mov reg, [base + disp] (0x8B) or mov [base + disp], reg (0x89)
+static void mov_mem(Assembler* a, uint8_t opcode, int reg, int base, int32_t disp) {
+    byte(a, 0x48 | ((reg >> 3) << 2) | (base >> 3));
+    byte(a, opcode);
+    byte(a, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) byte(a, 0x24);
+    u32(a, (uint32_t)disp);
+}
+
+static void load(Assembler* a, int reg, int base, int32_t disp) {
+    mov_mem(a, 0x8B, reg, base, disp);
+}
+
+static void store(Assembler* a, int base, int32_t disp, int reg) {
+    mov_mem(a, 0x89, reg, base, disp);
+}
+
+static void mov_imm(Assembler* a, int reg, uint64_t value) {
+    byte(a, 0x48 | (reg >> 3));
+    byte(a, 0xB8 + (reg & 7));
+    u64(a, value);
+}
+
+// A 64-bit register-to-register operation: opcode dst, src
+static void alu(Assembler* a, uint8_t opcode, int dst, int src) {
+    byte(a, 0x48 | ((src >> 3) << 2) | (dst >> 3));
+    byte(a, opcode);
+    byte(a, 0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+enum { ALU_ADD = 0x01, ALU_OR = 0x09, ALU_AND = 0x21, ALU_XOR = 0x31, ALU_CMP = 0x39, ALU_MOV = 0x89, ALU_TEST = 0x85 };
+
+// add r12, delta or sub r12, -delta
+static void adjust_sp(Assembler* a, int delta) {
+    byte(a, 0x49);
+    byte(a, 0x83);
+    byte(a, delta >= 0 ? 0xC4 : 0xEC);
+    byte(a, (uint8_t)(delta >= 0 ? delta : -delta));
+}
+
+// movq xmm0, rax / movq xmm1, rdx / movq rax, xmm0
+static void xmm0_from_rax(Assembler* a) { bytes(a, "\x66\x48\x0F\x6E\xC0", 5); }
+static void xmm1_from_rdx(Assembler* a) { bytes(a, "\x66\x48\x0F\x6E\xCA", 5); }
+static void rax_from_xmm0(Assembler* a) { bytes(a, "\x66\x48\x0F\x7E\xC0", 5); }
+
+// ucomisd xmm<x>, xmm<y>
+static void ucomisd(Assembler* a, int x, int y) {
+    bytes(a, "\x66\x0F\x2E", 3);
+    byte(a, 0xC0 | (x << 3) | y);
+}
+
+static void setcc(Assembler* a, int cc, int reg8) {
+    byte(a, 0x0F);
+    byte(a, 0x90 | cc);
+    byte(a, 0xC0 | reg8);
+}
+
+static void jump_to(Assembler* a, int target) {
+    byte(a, 0xE9);
+    add_fixup(&a->jumps, &a->jump_count, &a->jump_capacity, a->count, target);
+    u32(a, 0);
+}
+
+static void jcc_to(Assembler* a, int cc, int target) {
+    byte(a, 0x0F);
+    byte(a, 0x80 | cc);
+    add_fixup(&a->jumps, &a->jump_count, &a->jump_capacity, a->count, target);
+    u32(a, 0);
+}
+
+// Leave to the interpreter at instruction 'offset' if the condition holds
+static void jcc_exit(Assembler* a, int cc, int offset) {
+    byte(a, 0x0F);
+    byte(a, 0x80 | cc);
+    add_fixup(&a->exits, &a->exit_count, &a->exit_capacity, a->count, offset);
+    u32(a, 0);
+}
+
+// Save the stack top, record where to resume and return to C
+static void emit_exit(Assembler* a, int offset) {
+    store(a, RBX, 0, R12);
+    bytes(a, "\xC7\x83", 2);               // mov dword [rbx + disp32], imm32
+    u32(a, 24);
+    u32(a, (uint32_t)offset);
+    byte(a, 0xE9);
+    u32(a, (uint32_t)(a->epilogue - (a->count + 4)));
+}
+
+// Deoptimize instruction 'offset' unless 'reg' holds a number
+static void guard_number(Assembler* a, int reg, int offset) {
+    alu(a, ALU_MOV, RCX, reg);
+    alu(a, ALU_AND, RCX, R15);
+    alu(a, ALU_CMP, RCX, R15);
+    jcc_exit(a, CC_E, offset);
+}
+
+static void push_value(Assembler* a, Value value) {
+    mov_imm(a, RAX, value);
+    store(a, R12, 0, RAX);
+    adjust_sp(a, 8);
+}
+
+// Load the top two values into xmm0 (left) and xmm1 (right), deoptimizing
+// unless both are numbers
+static void number_operands(Assembler* a, int offset) {
+    load(a, RAX, R12, -16);
+    load(a, RDX, R12, -8);
+    guard_number(a, RAX, offset);
+    guard_number(a, RDX, offset);
+    xmm0_from_rax(a);
+    xmm1_from_rdx(a);
+}
+
+// Set al to the result of comparing xmm0 with xmm1. A NaN operand makes
+// every comparison but != false, as in C.
+static void compare_to_al(Assembler* a, OpCode op) {
+    switch (op) {
+    case OP_LT: case OP_LT_JUMP: ucomisd(a, 1, 0); setcc(a, CC_A, RAX); break;
+    case OP_LE: case OP_LE_JUMP: ucomisd(a, 1, 0); setcc(a, CC_AE, RAX); break;
+    case OP_GT: case OP_GT_JUMP: ucomisd(a, 0, 1); setcc(a, CC_A, RAX); break;
+    case OP_GE: case OP_GE_JUMP: ucomisd(a, 0, 1); setcc(a, CC_AE, RAX); break;
+    case OP_EQ: case OP_EQ_JUMP:
+        ucomisd(a, 0, 1);
+        setcc(a, CC_E, RAX);
+        setcc(a, CC_NP, RCX);
+        bytes(a, "\x20\xC8", 2);           // and al, cl
+        break;
+    default:                               // OP_NEQ, OP_NEQ_JUMP
+        ucomisd(a, 0, 1);
+        setcc(a, CC_NE, RAX);
+        setcc(a, CC_P, RCX);
+        bytes(a, "\x08\xC8", 2);           // or al, cl
+        break;
+    }
+}
+
+static int operand_count(OpCode op) {
+    switch (op) {
+    case OP_NULL: case OP_TRUE: case OP_FALSE: case OP_POP:
+    case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_NEGATE:
+    case OP_RANGE_INIT: case OP_LIST_INIT: case OP_RETURN: case OP_HALT:
+        return 0;
+    case OP_JUMP_IF_FALSE:
+    case OP_CALL: case OP_CALL_FUNCTION: case OP_TAIL_CALL: case OP_TAIL_CALL_FUNCTION:
+    case OP_CALL_BUILTIN:
+        return 2;
+    case OP_RANGE_NEXT: case OP_LIST_NEXT:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+static void compile_instruction(Assembler* a, Chunk* chunk, int offset) {
+    int* code = chunk->code;
+    OpCode op = (OpCode)code[offset];
+
+    switch (op) {
+    case OP_CONSTANT: {
+        // Only numbers are baked into the code; objects can move
+        Value value = chunk->constants[code[offset + 1]];
+        if (!IS_NUMBER(value)) {
+            emit_exit(a, offset);
+            break;
+        }
+        push_value(a, value);
+        break;
+    }
+    case OP_NULL:  push_value(a, NULL_VAL); break;
+    case OP_TRUE:  push_value(a, TRUE_VAL); break;
+    case OP_FALSE: push_value(a, FALSE_VAL); break;
+    case OP_POP:   adjust_sp(a, -8); break;
+    case OP_GET_LOCAL:
+    case OP_GET_GLOBAL:
+        load(a, RAX, op == OP_GET_LOCAL ? R13 : R14, 8 * code[offset + 1]);
+        store(a, R12, 0, RAX);
+        adjust_sp(a, 8);
+        break;
+    case OP_SET_LOCAL:
+    case OP_SET_GLOBAL:
+        load(a, RAX, R12, -8);
+        store(a, op == OP_SET_LOCAL ? R13 : R14, 8 * code[offset + 1], RAX);
+        break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+        number_operands(a, offset);
+        if (op == OP_DIV) {
+            // Division by zero is reported by the interpreter
+            bytes(a, "\x66\x0F\x57\xD2", 4);   // xorpd xmm2, xmm2
+            ucomisd(a, 1, 2);
+            bytes(a, "\x7A\x06", 2);           // jp over the je
+            jcc_exit(a, CC_E, offset);
+        }
+        byte(a, 0xF2);
+        byte(a, 0x0F);
+        byte(a, op == OP_ADD ? 0x58 : op == OP_SUB ? 0x5C : op == OP_MUL ? 0x59 : 0x5E);
+        byte(a, 0xC1);                         // <op>sd xmm0, xmm1
+        rax_from_xmm0(a);
+        store(a, R12, -16, RAX);
+        adjust_sp(a, -8);
+        break;
+    case OP_EQ: case OP_NEQ: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+        number_operands(a, offset);
+        compare_to_al(a, op);
+        bytes(a, "\x0F\xB6\xC0", 3);           // movzx eax, al
+        mov_imm(a, RDX, FALSE_VAL);
+        alu(a, ALU_ADD, RAX, RDX);             // TRUE_VAL is FALSE_VAL + 1
+        store(a, R12, -16, RAX);
+        adjust_sp(a, -8);
+        break;
+    case OP_EQ_JUMP: case OP_NEQ_JUMP: case OP_LT_JUMP:
+    case OP_LE_JUMP: case OP_GT_JUMP: case OP_GE_JUMP:
+        // The JUMP_IF_FALSE that follows holds the target
+        number_operands(a, offset);
+        compare_to_al(a, op);
+        adjust_sp(a, -16);
+        bytes(a, "\x84\xC0", 2);               // test al, al
+        jcc_to(a, CC_E, code[offset + 3]);
+        jump_to(a, offset + 5);
+        break;
+    case OP_NEGATE:
+        load(a, RAX, R12, -8);
+        guard_number(a, RAX, offset);
+        mov_imm(a, RDX, SIGN_BIT);
+        alu(a, ALU_XOR, RAX, RDX);
+        store(a, R12, -8, RAX);
+        break;
+    case OP_JUMP:
+        jump_to(a, code[offset + 1]);
+        break;
+    case OP_JUMP_IF_FALSE:
+        // rcx = 0 for false, 1 for true; anything else is left to the
+        // interpreter's error message
+        load(a, RAX, R12, -8);
+        alu(a, ALU_MOV, RCX, RAX);
+        mov_imm(a, RDX, FALSE_VAL);
+        alu(a, ALU_XOR, RCX, RDX);
+        bytes(a, "\x48\x83\xF9\x01", 4);       // cmp rcx, 1
+        jcc_exit(a, CC_A, offset);
+        adjust_sp(a, -8);
+        alu(a, ALU_TEST, RCX, RCX);
+        jcc_to(a, CC_E, code[offset + 1]);
+        break;
+    case OP_RANGE_NEXT: {
+        // Stack: [counter, end], both numbers since RANGE_INIT
+        int base = code[offset + 1] == SCOPE_LOCAL ? R13 : R14;
+        load(a, RAX, R12, -16);
+        load(a, RDX, R12, -8);
+        xmm0_from_rax(a);
+        xmm1_from_rdx(a);
+        ucomisd(a, 0, 1);
+        jcc_to(a, CC_A, code[offset + 3]);
+        store(a, base, 8 * code[offset + 2], RAX);
+        mov_imm(a, RDX, NUMBER_VAL(1));
+        xmm1_from_rdx(a);
+        bytes(a, "\xF2\x0F\x58\xC1", 4);       // addsd xmm0, xmm1
+        rax_from_xmm0(a);
+        store(a, R12, -16, RAX);
+        break;
+    }
+    default:
+        emit_exit(a, offset);
+        break;
+    }
+}
+
+JitCode* jit_compile(Chunk* chunk) {
+    Assembler a = {0};
+    a.labels = malloc(sizeof(int) * (chunk->count + 1));
+    for (int i = 0; i <= chunk->count; i++) a.labels[i] = -1;
+
+    // Entry: save callee-saved registers, load the state and jump to the
+    // instruction passed in rsi
+    bytes(&a, "\x53\x41\x54\x41\x55\x41\x56\x41\x57", 9);
+    alu(&a, ALU_MOV, RBX, RDI);
+    load(&a, R12, RBX, 0);
+    load(&a, R13, RBX, 8);
+    load(&a, R14, RBX, 16);
+    mov_imm(&a, R15, QNAN);
+    bytes(&a, "\xFF\xE6", 2);                  // jmp rsi
+    a.epilogue = a.count;
+    bytes(&a, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5B\xC3", 10);
+
+    for (int offset = 0; offset < chunk->count; offset += 1 + operand_count((OpCode)chunk->code[offset])) {
+        a.labels[offset] = a.count;
+        compile_instruction(&a, chunk, offset);
+    }
+    // Running off the end cannot happen (chunks end in RETURN or HALT),
+    // but the label keeps every jump target defined
+    a.labels[chunk->count] = a.count;
+    emit_exit(&a, chunk->count);
+
+    for (int i = 0; i < a.jump_count; i++) {
+        patch32(&a, a.jumps[i].at, a.labels[a.jumps[i].target]);
+    }
+    for (int i = 0; i < a.exit_count; i++) {
+        patch32(&a, a.exits[i].at, a.count);
+        emit_exit(&a, a.exits[i].target);
+    }
+    free(a.jumps);
+    free(a.exits);
+
+    // Write the code, then make it executable but no longer writable
+    JitCode* jit = NULL;
+    size_t size = (size_t)a.count;
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED) {
+        memcpy(memory, a.bytes, size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) == 0) {
+            jit = malloc(sizeof(JitCode));
+            jit->code = memory;
+            jit->size = size;
+            jit->labels = a.labels;
+        } else {
+            munmap(memory, size);
+        }
+    }
+    if (!jit) free(a.labels);
+    free(a.bytes);
+    return jit;
+}
+
+int* jit_run(Chunk* chunk, int* ip, Value** sp, Value* slots, Value* globals) {
+    JitCode* jit = chunk->jit;
+    JitState state = {*sp, slots, globals, 0};
+    JitEntry entry = (JitEntry)(void*)jit->code;
+    entry(&state, jit->code + jit->labels[ip - chunk->code]);
+    *sp = state.sp;
+    return chunk->code + state.exit;
+}
+
+void jit_free(JitCode* jit) {
+    munmap(jit->code, jit->size);
+    free(jit->labels);
+    free(jit);
+}
+
+bool jit_supported(void) {
+    return true;
+}
+
+#else
+
+JitCode* jit_compile(Chunk* chunk) {
+    (void)chunk;
+    return NULL;
+}
+
+int* jit_run(Chunk* chunk, int* ip, Value** sp, Value* slots, Value* globals) {
+    (void)chunk; (void)sp; (void)slots; (void)globals;
+    return ip;
+}
+
+void jit_free(JitCode* jit) {
+    (void)jit;
+}
+
+bool jit_supported(void) {
+    return false;
+}
+
+#endif
+
+// Count one more entry into a chunk and compile it once it is hot. A chunk
+// that fails to compile is not tried again.
+bool jit_hot(Chunk* chunk) {
+    if (chunk->hotness < 0 || ++chunk->hotness < options.jit_threshold) return false;
+    chunk->jit = jit_compile(chunk);
+    if (!chunk->jit) chunk->hotness = -1;
+    return chunk->jit != NULL;
+}
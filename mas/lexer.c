@@ -1,34 +1,128 @@
 // lexer.c
 #include "mas.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-static char* current;
+// Tokens are slices of the source buffer: nothing is copied while lexing.
+// Source files are mapped into memory where the system supports it, so even
+// very large scripts are never duplicated on the heap. The parser turns the
+// slices it keeps into atoms, numbers and strings (token_number,
+// token_string).
+
+static const char* current;
+static const char* end;
+static const char* token_start;     // where the last token handed out begins
+static const char* unreleased = NULL; // first mapped page still wanted
 static int line = 1;
-static FILE* file;
 static bool eof_reached = false;
 
 ExecutionMode mode;
 
+// Character classes, indexed by byte. Bytes outside ASCII belong to no
+// class, as with isalpha and isdigit in the C locale.
+enum {
+    CHAR_BLANK = 1,            // skipped between tokens: space, tab, \r
+    CHAR_IDENT_START = 2,      // letters and '_'
+    CHAR_IDENT = 4,            // letters, digits and '_'
+    CHAR_DIGIT = 8
+};
+
+static uint8_t char_class[256];
+
+static void init_char_classes() {
+    if (char_class['_']) return;
+    char_class[' '] = char_class['\t'] = char_class['\r'] = CHAR_BLANK;
+    char_class['_'] = CHAR_IDENT_START | CHAR_IDENT;
+    for (int c = 'a'; c <= 'z'; c++) {
+        char_class[c] = char_class[c - 'a' + 'A'] = CHAR_IDENT_START | CHAR_IDENT;
+    }
+    for (int c = '0'; c <= '9'; c++) {
+        char_class[c] = CHAR_IDENT | CHAR_DIGIT;
+    }
+}
+
+static bool has_class(int c, int mask) {
+    return c != EOF && (char_class[(unsigned char)c] & mask);
+}
+
+// Read the whole input into a heap buffer when it cannot be mapped. A pipe
+// has no size up front, so the buffer grows until EOF.
+static const char* read_source(FILE* f, size_t* size) {
+    size_t capacity = 64 * 1024;
+    size_t length = 0;
+    char* buffer = malloc(capacity);
+    size_t n;
+    while ((n = fread(buffer + length, 1, capacity - length, f)) > 0) {
+        length += n;
+        if (length == capacity) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+        }
+    }
+    *size = length;
+    return buffer;
+}
+
 void lexer_init(FILE* f) {
     //Setting the lexer mode
     mode = FILE_MODE;
-    file = f;
-    current = NULL;
+    size_t size = 0;
+    const char* source = NULL;
+
+#ifndef _WIN32
+    // The mapping stays valid after the file is closed
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (mapped != MAP_FAILED) {
+            source = mapped;
+            size = (size_t)st.st_size;
+            unreleased = source;
+        }
+    }
+#endif
+    if (!source) {
+        source = read_source(f, &size);
+    }
+    current = source;
+    end = source + size;
+    init_char_classes();
 }
 
+// Lets the system drop the pages of a mapped source that lie wholly before
+// the last token handed out; the parser never looks further back. With
+// --stream this keeps the resident part of a huge script small. Pages are
+// released a megabyte or more at a time.
+void lexer_release_consumed() {
+#ifndef _WIN32
+    if (!unreleased) return;
+    uintptr_t page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+    const char* limit = (const char*)((uintptr_t)token_start & ~page_mask);
+    if (limit - unreleased >= 1024 * 1024) {
+        madvise((void*)unreleased, (size_t)(limit - unreleased), MADV_DONTNEED);
+        unreleased = limit;
+    }
+#endif
+}
+
+// The REPL line outlives parsing, so it is lexed in place
 void lexer_init_repl(char* code){
     //Setting the lexer mode
     mode = REPL_MODE;
-
-    int size = strlen(code);
-    char* buffer = malloc(size + 1);
-    strcpy(buffer, code);
-    buffer[size] = '\0';
-    current = buffer;
+    current = code;
+    end = code + strlen(code);
+    init_char_classes();
 }
 
 // Helper function to read next character
 static int next_char() {    
-    if (current && *current) {
+    if (current < end) {
         char c = *current++;
         if (c == '\n') line++;
         return c;
@@ -38,220 +132,271 @@ static int next_char() {
 
 // Helper function to peek at next character
 static int peek_char() {
-    if (current && *current != '\0') {
-        return *current;
+    if (current < end) {
+        return (unsigned char)*current;
     }
     return EOF;
 }
 
-// Skip whitespace
+static Token make_token(TokenType type, const char* start, size_t length, int line_num) {
+    Token tok;
+    tok.type = type;
+    tok.start = start;
+    tok.length = length;
+    tok.line = line_num;
+    return tok;
+}
+
+// Error tokens point at a message instead of the source
+static Token error_token(const char* message) {
+    return make_token(TOK_ERROR, message, strlen(message), line);
+}
+
+// First byte at or after p that is not a blank. Neither blanks nor comment
+// text contain '\n', so skipping them never changes the line number.
+static const char* skip_blanks(const char* p) {
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                     _mm_cmpeq_epi8(chunk, cr));
+        int mask = ~_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && (char_class[(unsigned char)*p] & CHAR_BLANK)) p++;
+    return p;
+}
+
+// The '\n' or '\r' that ends the line holding p, or the end of the source
+static const char* find_line_end(const char* p) {
+#if defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, nl), _mm_cmpeq_epi8(chunk, cr)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '\n' && *p != '\r') p++;
+    return p;
+}
+
+// Skip blanks and comments. The newline ending a comment is left for
+// lexer_next(); a '\r' before it is a blank.
 static void skip_whitespace() {
-    int c;
-    while ((c = peek_char()) != EOF) {
-        if (c == ' ' || c == '\t') {
-            next_char();
-        } else if (c == '\r') {
-            // Skip \r (in case of \r\n or lone \r)
-            next_char();
-            // If followed by \n, we'll let lexer_next() handle the \n
-        } else if (c == '#') {
-            next_char(); // consume '#'
-            while ((c = peek_char()) != EOF && c != '\n' && c != '\r') {
-                next_char();
-            }
-            // Do NOT consume \n or \r — leave for lexer_next()
+    for (;;) {
+        current = skip_blanks(current);
+        if (current < end && *current == '#') {
+            current = find_line_end(current + 1);
         } else {
             break;
         }
     }
 }
 
+// Keywords are picked out by length and first character; a single memcmp
+// then confirms the candidate
+static TokenType keyword_type(const char* s, size_t length) {
+#define KEYWORD(word, type) return memcmp(s, word, length) == 0 ? type : TOK_ID
+    switch (length) {
+    case 2:
+        switch (s[0]) {
+        case 'i': return s[1] == 'n' ? KW_IN : s[1] == 'f' ? KW_IF : TOK_ID;
+        case 't': KEYWORD("to", KW_TO);
+        }
+        break;
+    case 3:
+        switch (s[0]) {
+        case 'd': KEYWORD("def", KW_DEF);
+        case 'e': KEYWORD("end", TOK_END);
+        }
+        break;
+    case 4:
+        switch (s[0]) {
+        case 'l': KEYWORD("loop", KW_LOOP);
+        case 's': KEYWORD("stop", KW_STOP);
+        case 'n': return memcmp(s, "next", 4) == 0 ? KW_NEXT : memcmp(s, "null", 4) == 0 ? KW_NULL : TOK_ID;
+        case 'g': KEYWORD("give", KW_GIVE);
+        case 't': KEYWORD("true", KW_TRUE);
+        case 'e':
+            if (memcmp(s, "each", 4) == 0) return KW_EACH;
+            if (memcmp(s, "elif", 4) == 0) return KW_ELIF;
+            KEYWORD("else", KW_ELSE);
+        }
+        break;
+    case 5:
+        switch (s[0]) {
+        case 'f': KEYWORD("false", KW_FALSE);
+        case 'p': KEYWORD("print", KW_PRINT);
+        }
+        break;
+    }
+    return TOK_ID;
+#undef KEYWORD
+}
+
 // Read identifier or keyword
-static Token* read_identifier() {
-    char buffer[256];
-    int i = 0;
-    int c = peek_char();
-    while ((c != EOF) && (isalpha(c) || c == '_' || (i > 0 && isdigit(c)))) {
-        buffer[i++] = next_char();
-        c = peek_char();
+static Token read_identifier() {
+    const char* start = current;
+    while (current < end && (char_class[(unsigned char)*current] & CHAR_IDENT)) {
+        current++;
     }
-    buffer[i] = '\0';
-    
-    Token* tok = malloc(sizeof(Token));
-    tok->line = line;
-    tok->value = strdup(buffer);
-    
-    // Check for keywords
-    if (strcmp(buffer, "loop") == 0) tok->type = KW_LOOP;
-    else if (strcmp(buffer, "each") == 0) tok->type = KW_EACH;
-    else if (strcmp(buffer, "in") == 0) tok->type = KW_IN;
-    else if (strcmp(buffer, "to") == 0) tok->type = KW_TO;
-    else if (strcmp(buffer, "stop") == 0) tok->type = KW_STOP;
-    else if (strcmp(buffer, "next") == 0) tok->type = KW_NEXT;
-    else if (strcmp(buffer, "give") == 0) tok->type = KW_GIVE;
-    else if (strcmp(buffer, "if") == 0) tok->type = KW_IF;
-    else if (strcmp(buffer, "elif") == 0) tok->type = KW_ELIF;
-    else if (strcmp(buffer, "else") == 0) tok->type = KW_ELSE;
-    else if (strcmp(buffer, "def") == 0) tok->type = KW_DEF;
-    else if (strcmp(buffer, "true") == 0) tok->type = KW_TRUE;
-    else if (strcmp(buffer, "false") == 0) tok->type = KW_FALSE;
-    else if (strcmp(buffer, "null") == 0) tok->type = KW_NULL;
-    else if (strcmp(buffer, "print") == 0) tok->type = KW_PRINT;
-    else if (strcmp(buffer, "end") == 0) tok->type = TOK_END;
-    else tok->type = TOK_ID;
-    // printf("LEXED IDENTIFIER: '%s' -> TOKEN %d\n", buffer, tok->type);
-    return tok;
+    size_t length = (size_t)(current - start);
+    return make_token(keyword_type(start, length), start, length, line);
 }
 
 // Read number
-static Token* read_number() {
-    char buffer[256];
-    int i = 0;
+static Token read_number() {
+    const char* start = current;
     int c = peek_char();
     bool has_decimal = false;
     
-    while ((c != EOF) && (isdigit(c) || c == '.')) {
+    while (has_class(c, CHAR_DIGIT) || c == '.') {
         if (c == '.') {
             if (has_decimal) break;
             has_decimal = true;
         }
-        buffer[i++] = next_char();
+        next_char();
         c = peek_char();
     }
-    buffer[i] = '\0';
-    
-    Token* tok = malloc(sizeof(Token));
-    tok->type = TOK_NUMBER;
-    tok->value = strdup(buffer);
-    tok->line = line;
-    return tok;
+    return make_token(TOK_NUMBER, start, (size_t)(current - start), line);
 }
 
-// Read string
-static Token* read_string() {
-    char buffer[1024];
-    int i = 0;
+// Read string. The slice is the text between the quotes with its escapes
+// still in it; token_string decodes them.
+static Token read_string() {
     char quote = next_char(); // consume opening quote
+    const char* start = current;
     int c = next_char();
     
     while (c != EOF && c != quote) {
         if (c == '\\') {
-            c = next_char();
-            if (c == 'n') buffer[i++] = '\n';
-            else if (c == 't') buffer[i++] = '\t';
-            else if (c == '\\' || c == '"' || c == '\'') buffer[i++] = c;
-            else {
-                buffer[i++] = '\\';
-                buffer[i++] = c;
-            }
-        } else {
-            buffer[i++] = c;
+            next_char();
         }
         c = next_char();
     }
-    buffer[i] = '\0';
     
     if (c != quote) {
         // Unterminated string
-        Token* tok = malloc(sizeof(Token));
-        tok->type = TOK_ERROR;
-        tok->value = strdup("Unterminated string");
-        tok->line = line;
-        return tok;
+        return error_token("Unterminated string");
     }
-    
-    Token* tok = malloc(sizeof(Token));
-    tok->type = TOK_STRING;
-    tok->value = strdup(buffer);
-    tok->line = line;
-    return tok;
+    return make_token(TOK_STRING, start, (size_t)(current - 1 - start), line);
 }
 
-static Token* make_token(TokenType type, char* value, int line_num) {
-    Token* tok = malloc(sizeof(Token));
-    if (!tok) {
-        perror("Failed to allocate token");
-        exit(1);
+double token_number(const Token* tok) {
+    // The slice is not terminated; numbers are short, so copy the digits
+    char buffer[64];
+    if (tok->length < sizeof(buffer)) {
+        memcpy(buffer, tok->start, tok->length);
+        buffer[tok->length] = '\0';
+        return atof(buffer);
     }
-    tok->type = type;
-    tok->value = value;
-    tok->line = line_num;
-    return tok;
+    char* copy = malloc(tok->length + 1);
+    memcpy(copy, tok->start, tok->length);
+    copy[tok->length] = '\0';
+    double number = atof(copy);
+    free(copy);
+    return number;
 }
 
-// Main lexer function
-Token* lexer_next() {
-    if (!current && mode == FILE_MODE) {
-        // Read entire file into memory
-        fseek(file, 0, SEEK_END);
-        long size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        char* buffer = malloc(size + 1);
-        fread(buffer, 1, size, file);
-        buffer[size] = '\0';
-        current = buffer;
+// Copies a string token's text into value (tok->length + 1 bytes), decoding
+// escapes if it has any
+void token_string(const Token* tok, char* value) {
+    if (!memchr(tok->start, '\\', tok->length)) {
+        memcpy(value, tok->start, tok->length);
+        value[tok->length] = '\0';
+        return;
     }
-    
+
+    size_t i = 0;
+    for (const char* c = tok->start; c < tok->start + tok->length; c++) {
+        if (*c != '\\') {
+            value[i++] = *c;
+            continue;
+        }
+        // A string never ends in a lone backslash: it would escape the quote
+        c++;
+        if (*c == 'n') value[i++] = '\n';
+        else if (*c == 't') value[i++] = '\t';
+        else if (*c == '\\' || *c == '"' || *c == '\'') value[i++] = *c;
+        else {
+            value[i++] = '\\';
+            value[i++] = *c;
+        }
+    }
+    value[i] = '\0';
+}
+
+// Main lexer function
+Token lexer_next() {
     skip_whitespace();
+    token_start = current;
     
     int c = peek_char();
     // Single character tokens
-    if (c == '+') { next_char(); return make_token(TOK_PLUS, NULL, line); }
-    if (c == '-') { next_char(); return make_token(TOK_MINUS, NULL, line); }
-    if (c == '*') { next_char(); return make_token(TOK_TIMES, NULL, line); }
-    if (c == '/') { next_char(); return make_token(TOK_DIVIDE, NULL, line); }
-    if (c == '(') { next_char(); return make_token(TOK_LPAREN, NULL, line); }
-    if (c == ')') { next_char(); return make_token(TOK_RPAREN, NULL, line); }
-    if (c == '[') { next_char(); return make_token(TOK_LBRACKET, NULL, line); }
-    if (c == ']') { next_char(); return make_token(TOK_RBRACKET, NULL, line); }
-    if (c == '{') { next_char(); return make_token(TOK_LBRACE, NULL, line); }
-    if (c == '}') { next_char(); return make_token(TOK_RBRACE, NULL, line); }
-    if (c == ',') { next_char(); return make_token(TOK_COMMA, NULL, line); }
-    if (c == ':') { next_char(); return make_token(TOK_COLON, NULL, line); }
+    if (c == '+') { next_char(); return make_token(TOK_PLUS, NULL, 0, line); }
+    if (c == '-') { next_char(); return make_token(TOK_MINUS, NULL, 0, line); }
+    if (c == '*') { next_char(); return make_token(TOK_TIMES, NULL, 0, line); }
+    if (c == '/') { next_char(); return make_token(TOK_DIVIDE, NULL, 0, line); }
+    if (c == '(') { next_char(); return make_token(TOK_LPAREN, NULL, 0, line); }
+    if (c == ')') { next_char(); return make_token(TOK_RPAREN, NULL, 0, line); }
+    if (c == '[') { next_char(); return make_token(TOK_LBRACKET, NULL, 0, line); }
+    if (c == ']') { next_char(); return make_token(TOK_RBRACKET, NULL, 0, line); }
+    if (c == '{') { next_char(); return make_token(TOK_LBRACE, NULL, 0, line); }
+    if (c == '}') { next_char(); return make_token(TOK_RBRACE, NULL, 0, line); }
+    if (c == ',') { next_char(); return make_token(TOK_COMMA, NULL, 0, line); }
+    if (c == ':') { next_char(); return make_token(TOK_COLON, NULL, 0, line); }
     if (c == '=') {
         next_char();
         if (peek_char() == '=') {
             next_char();
-            return make_token(TOK_EQ, NULL, line);
+            return make_token(TOK_EQ, NULL, 0, line);
         }
-        return make_token(TOK_ASSIGN, NULL, line);
+        return make_token(TOK_ASSIGN, NULL, 0, line);
     }
     if (c == '!') {
         next_char();
         if (peek_char() == '=') {
             next_char();
-            return make_token(TOK_NEQ, NULL, line);
+            return make_token(TOK_NEQ, NULL, 0, line);
         }
         // Error: unexpected '!'
-        return make_token(TOK_ERROR, strdup("Unexpected '!'"), line);
+        return error_token("Unexpected '!'");
     }
     if (c == '<') {
         next_char();
         if (peek_char() == '=') {
             next_char();
-            return make_token(TOK_LE, NULL, line);
+            return make_token(TOK_LE, NULL, 0, line);
         }
-        return make_token(TOK_LT, NULL, line);
+        return make_token(TOK_LT, NULL, 0, line);
     }
     if (c == '>') {
         next_char();
         if (peek_char() == '=') {
             next_char();
-            return make_token(TOK_GE, NULL, line);
+            return make_token(TOK_GE, NULL, 0, line);
         }
-        return make_token(TOK_GT, NULL, line);
+        return make_token(TOK_GT, NULL, 0, line);
     }
     if (c == '\n') {
         next_char();
         // The newline token belongs to the line we just finished.
-        return make_token(TOK_NEWLINE, NULL, line - 1);
+        return make_token(TOK_NEWLINE, NULL, 0, line - 1);
     }
     
     // Multi-character tokens
-    if (isalpha(c) || c == '_') {
+    if (has_class(c, CHAR_IDENT_START)) {
         return read_identifier();
     }
-    if (isdigit(c)) {
+    if (has_class(c, CHAR_DIGIT)) {
         return read_number();
     }
     if (c == '"' || c == '\'') {
@@ -260,91 +405,85 @@ Token* lexer_next() {
     
     if (c == EOF) {
         eof_reached = true;
-        return make_token(TOK_EOF, NULL, line);
+        return make_token(TOK_EOF, NULL, 0, line);
     }
 
-    // Unknown character
-    char msg[100];
+    // Unknown character. The message lives until the next error token.
+    static char msg[100];
     if (isprint(c)) {
         sprintf(msg, "Unknown character: '%c'", c);
     } else {
         sprintf(msg, "Unknown character: '\\x%02X'", (unsigned char)c);
     }
     next_char(); // consume it
-    return make_token(TOK_ERROR, strdup(msg), line);
+    return error_token(msg);
 }
 
 // Add this at the bottom of lexer.c (or anywhere after lexer_next is defined)
 void print_tokens() {
-    Token* tok;
+    Token tok;
     do {
         tok = lexer_next();
-        switch (tok->type) {
+        switch (tok.type) {
             case TOK_EOF:
                 printf("EOF\n");
-                free(tok);
                 break;
             case TOK_ERROR:
-                printf("ERROR (line %d): %s\n", tok->line, tok->value);
+                printf("ERROR (line %d): %.*s\n", tok.line, (int)tok.length, tok.start);
                 break;
             case TOK_NUMBER:
-                printf("NUMBER (line %d): %s\n", tok->line, tok->value);
+                printf("NUMBER (line %d): %.*s\n", tok.line, (int)tok.length, tok.start);
                 break;
             case TOK_STRING:
-                printf("STRING (line %d): \"%s\"\n", tok->line, tok->value);
+                printf("STRING (line %d): \"%.*s\"\n", tok.line, (int)tok.length, tok.start);
                 break;
             case TOK_ID:
-                printf("IDENTIFIER (line %d): %s\n", tok->line, tok->value);
+                printf("IDENTIFIER (line %d): %.*s\n", tok.line, (int)tok.length, tok.start);
                 break;
             case TOK_NEWLINE:
-                printf("NEWLINE (line %d)\n", tok->line);
+                printf("NEWLINE (line %d)\n", tok.line);
                 break;
-            case TOK_PLUS:     printf("PLUS (line %d)\n", tok->line); break;
-            case TOK_MINUS:    printf("MINUS (line %d)\n", tok->line); break;
-            case TOK_TIMES:    printf("TIMES (line %d)\n", tok->line); break;
-            case TOK_DIVIDE:   printf("DIVIDE (line %d)\n", tok->line); break;
-            case TOK_ASSIGN:   printf("ASSIGN (line %d)\n", tok->line); break;
-            case TOK_EQ:       printf("EQ (line %d)\n", tok->line); break;
-            case TOK_NEQ:      printf("NEQ (line %d)\n", tok->line); break;
-            case TOK_LT:       printf("LT (line %d)\n", tok->line); break;
-            case TOK_LE:       printf("LE (line %d)\n", tok->line); break;
-            case TOK_GT:       printf("GT (line %d)\n", tok->line); break;
-            case TOK_GE:       printf("GE (line %d)\n", tok->line); break;
-            case TOK_LPAREN:   printf("LPAREN (line %d)\n", tok->line); break;
-            case TOK_RPAREN:   printf("RPAREN (line %d)\n", tok->line); break;
-            case TOK_LBRACKET: printf("LBRACKET (line %d)\n", tok->line); break;
-            case TOK_RBRACKET: printf("RBRACKET (line %d)\n", tok->line); break;
-            case TOK_LBRACE:   printf("LBRACE (line %d)\n", tok->line); break;
-            case TOK_RBRACE:   printf("RBRACE (line %d)\n", tok->line); break;
-            case TOK_COMMA:    printf("COMMA (line %d)\n", tok->line); break;
-            case TOK_COLON:    printf("COLON (line %d)\n", tok->line); break;
-            case TOK_END:      printf("END (line %d)\n", tok->line); break;
+            case TOK_PLUS:     printf("PLUS (line %d)\n", tok.line); break;
+            case TOK_MINUS:    printf("MINUS (line %d)\n", tok.line); break;
+            case TOK_TIMES:    printf("TIMES (line %d)\n", tok.line); break;
+            case TOK_DIVIDE:   printf("DIVIDE (line %d)\n", tok.line); break;
+            case TOK_ASSIGN:   printf("ASSIGN (line %d)\n", tok.line); break;
+            case TOK_EQ:       printf("EQ (line %d)\n", tok.line); break;
+            case TOK_NEQ:      printf("NEQ (line %d)\n", tok.line); break;
+            case TOK_LT:       printf("LT (line %d)\n", tok.line); break;
+            case TOK_LE:       printf("LE (line %d)\n", tok.line); break;
+            case TOK_GT:       printf("GT (line %d)\n", tok.line); break;
+            case TOK_GE:       printf("GE (line %d)\n", tok.line); break;
+            case TOK_LPAREN:   printf("LPAREN (line %d)\n", tok.line); break;
+            case TOK_RPAREN:   printf("RPAREN (line %d)\n", tok.line); break;
+            case TOK_LBRACKET: printf("LBRACKET (line %d)\n", tok.line); break;
+            case TOK_RBRACKET: printf("RBRACKET (line %d)\n", tok.line); break;
+            case TOK_LBRACE:   printf("LBRACE (line %d)\n", tok.line); break;
+            case TOK_RBRACE:   printf("RBRACE (line %d)\n", tok.line); break;
+            case TOK_COMMA:    printf("COMMA (line %d)\n", tok.line); break;
+            case TOK_COLON:    printf("COLON (line %d)\n", tok.line); break;
+            case TOK_END:      printf("END (line %d)\n", tok.line); break;
 
             // Keywords
-            case KW_LOOP:   printf("KW_LOOP (line %d)\n", tok->line); break;
-            case KW_EACH:   printf("KW_EACH (line %d)\n", tok->line); break;
-            case KW_IN:     printf("KW_IN (line %d)\n", tok->line); break;
-            case KW_TO:     printf("KW_TO (line %d)\n", tok->line); break;
-            case KW_STOP:   printf("KW_STOP (line %d)\n", tok->line); break;
-            case KW_NEXT:   printf("KW_NEXT (line %d)\n", tok->line); break;
-            case KW_GIVE:   printf("KW_GIVE (line %d)\n", tok->line); break;
-            case KW_IF:     printf("KW_IF (line %d)\n", tok->line); break;
-            case KW_ELIF:   printf("KW_ELIF (line %d)\n", tok->line); break;
-            case KW_ELSE:   printf("KW_ELSE (line %d)\n", tok->line); break;
-            case KW_DEF:    printf("KW_DEF (line %d)\n", tok->line); break;
-            case KW_TRUE:   printf("KW_TRUE (line %d)\n", tok->line); break;
-            case KW_FALSE:  printf("KW_FALSE (line %d)\n", tok->line); break;
-            case KW_NULL:   printf("KW_NULL (line %d)\n", tok->line); break;
-            case KW_PRINT:  printf("KW_PRINT (line %d)\n", tok->line); break;
+            case KW_LOOP:   printf("KW_LOOP (line %d)\n", tok.line); break;
+            case KW_EACH:   printf("KW_EACH (line %d)\n", tok.line); break;
+            case KW_IN:     printf("KW_IN (line %d)\n", tok.line); break;
+            case KW_TO:     printf("KW_TO (line %d)\n", tok.line); break;
+            case KW_STOP:   printf("KW_STOP (line %d)\n", tok.line); break;
+            case KW_NEXT:   printf("KW_NEXT (line %d)\n", tok.line); break;
+            case KW_GIVE:   printf("KW_GIVE (line %d)\n", tok.line); break;
+            case KW_IF:     printf("KW_IF (line %d)\n", tok.line); break;
+            case KW_ELIF:   printf("KW_ELIF (line %d)\n", tok.line); break;
+            case KW_ELSE:   printf("KW_ELSE (line %d)\n", tok.line); break;
+            case KW_DEF:    printf("KW_DEF (line %d)\n", tok.line); break;
+            case KW_TRUE:   printf("KW_TRUE (line %d)\n", tok.line); break;
+            case KW_FALSE:  printf("KW_FALSE (line %d)\n", tok.line); break;
+            case KW_NULL:   printf("KW_NULL (line %d)\n", tok.line); break;
+            case KW_PRINT:  printf("KW_PRINT (line %d)\n", tok.line); break;
 
             default:
-                printf("UNKNOWN TOKEN (line %d): %s\n", tok->line, tok->value ? tok->value : "(null)");
+                printf("UNKNOWN TOKEN (line %d)\n", tok.line);
                 break;
         }
-
-        // Free token memory if you're using malloc in lexer_next
-        if (tok->value) free(tok->value);
-        free(tok);
-
-    } while (tok->type != TOK_EOF);
+    } while (tok.type != TOK_EOF);
 }
\ No newline at end of file
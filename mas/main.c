@@ -2,13 +2,151 @@
 #include "mas.h"
 #include <stdio.h>
 
+Options options;
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] [file]\n", prog);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --ast-interp          Run with the tree-walking interpreter instead of the bytecode VM\n");
+    fprintf(stderr, "  --dump-ast            Print the program's AST after optimization instead of running it\n");
+    fprintf(stderr, "  --stream              Parse, run and free one top-level statement at a time\n");
+    fprintf(stderr, "  --gc-threshold=BYTES  Old space size that triggers the first major collection (MAS_GC_THRESHOLD)\n");
+    fprintf(stderr, "  --gc-growth=FACTOR    Heap growth allowed after each collection (MAS_GC_GROWTH)\n");
+    fprintf(stderr, "  --gc-nursery=BYTES    Size of the young generation (MAS_GC_NURSERY)\n");
+    fprintf(stderr, "  --gc-max-pause-us=N   Collect the old space incrementally, pausing at most N us (MAS_GC_MAX_PAUSE_US)\n");
+    fprintf(stderr, "  --gc-stress           Collect before every allocation (MAS_GC_STRESS=1)\n");
+    fprintf(stderr, "  --gc-stats            Print collector statistics at exit (MAS_GC_STATS=1)\n");
+    fprintf(stderr, "  --quicken-stats       Print hit and miss counts of specialized operations at exit\n");
+    fprintf(stderr, "  --jit                 Compile hot functions and loops to native code (x86-64 Linux)\n");
+    fprintf(stderr, "  --jit-threshold=N     Calls or loop iterations before a function or loop is compiled (default 1000)\n");
+}
+
+static Value run(ASTNode* ast) {
+    resolve_program(ast);
+    optimize_program(ast);
+    if (options.dump_ast) {
+        print_ast(ast, 0);
+        return NULL_VAL;
+    }
+    if (options.ast_interp) {
+        return interpret(ast);
+    }
+    return vm_interpret(ast);
+}
+
+// --stream: each top-level statement is parsed, run and freed before the
+// next one is read. Statements that define functions are kept, since the
+// functions are still called after the statement ends.
+static void run_stream(void) {
+    Arena functions = {0};
+    bool defines_function;
+    ASTNode* program;
+
+    if (options.ast_interp) {
+        interpret_begin();
+    } else {
+        vm_begin();
+    }
+    while ((program = parse_next_statement(&defines_function))) {
+        resolve_program(program);
+        optimize_program(program);
+        if (options.dump_ast) {
+            for (int i = 0; i < program->data.list.count; i++) {
+                print_ast(program->data.list.items[i], 0);
+            }
+        } else if (options.ast_interp) {
+            interpret_next(program);
+        } else {
+            vm_next(program);
+        }
+        if (defines_function) {
+            arena_move(&functions, &ast_arena);
+        } else {
+            arena_free(&ast_arena);
+        }
+        lexer_release_consumed();
+    }
+    if (options.ast_interp) {
+        interpret_end();
+    } else {
+        vm_end();
+    }
+    arena_free(&functions);
+}
 
 int main(int argc, char* argv[]) {
-    if(argc >2){
-        fprintf(stderr, "Too many arguments provided\n");
-        return 1;
+    const char* path = NULL;
+
+    gc_config_from_env();
+    options.jit_threshold = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ast-interp") == 0) {
+            options.ast_interp = true;
+        }
+        else if (strcmp(argv[i], "--dump-ast") == 0) {
+            options.dump_ast = true;
+        }
+        else if (strcmp(argv[i], "--stream") == 0) {
+            options.stream = true;
+        }
+        else if (strncmp(argv[i], "--gc-threshold=", 15) == 0) {
+            gc_config.threshold = strtoull(argv[i] + 15, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--gc-growth=", 12) == 0) {
+            gc_config.growth = strtod(argv[i] + 12, NULL);
+        }
+        else if (strncmp(argv[i], "--gc-nursery=", 13) == 0) {
+            gc_config.nursery = strtoull(argv[i] + 13, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--gc-max-pause-us=", 18) == 0) {
+            gc_config.max_pause_us = strtol(argv[i] + 18, NULL, 10);
+        }
+        else if (strcmp(argv[i], "--gc-stress") == 0) {
+            gc_config.stress = true;
+        }
+        else if (strcmp(argv[i], "--gc-stats") == 0) {
+            gc_config.stats = true;
+        }
+        else if (strcmp(argv[i], "--quicken-stats") == 0) {
+            options.quicken_stats = true;
+        }
+        else if (strcmp(argv[i], "--jit") == 0) {
+            options.jit = true;
+        }
+        else if (strncmp(argv[i], "--jit-threshold=", 16) == 0) {
+            options.jit_threshold = (int)strtol(argv[i] + 16, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        else if (path) {
+            fprintf(stderr, "Too many arguments provided\n");
+            return 1;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (gc_config.growth < 1.0) {
+        gc_config.growth = 1.0;
     }
-    else if(argc == 1){
+    if (gc_config.stats) {
+        atexit(gc_print_stats);
+    }
+    if (options.jit && !jit_supported()) {
+        fprintf(stderr, "--jit is only available on x86-64 Linux; running without it\n");
+        options.jit = false;
+    }
+    if (options.jit_threshold < 1) {
+        options.jit_threshold = 1;
+    }
+    if (options.quicken_stats) {
+        atexit(quick_print_stats);
+    }
+
+    if(!path){
         // REPL mode
         printf("MAS Programming Language REPL \n");
         printf("Type 'exit to quit\n");
@@ -27,24 +165,32 @@ int main(int argc, char* argv[]) {
 
             lexer_init_repl(input);
             ASTNode* ast = parse_program();
-            interpret(ast);
+            run(ast);
+            arena_free(&ast_arena);
         }
     }
     else{
         //Execution from file
-         FILE* f = fopen(argv[1], "rb");
+         FILE* f = fopen(path, "rb");
         if (!f) {
             perror("Failed to open file");
             return 1;
         }
 
         lexer_init(f);
-        
+
+        if (options.stream) {
+            run_stream();
+            fclose(f);
+            return 0;
+        }
+
         ASTNode* ast = parse_program();
         fclose(f);
-        
-        interpret(ast);
+
+        run(ast);
+        arena_free(&ast_arena);
     }
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 //Declaration for REPL mode size
 #define REPL_INPUT_SIZE 1024
@@ -23,10 +24,12 @@ typedef enum {
     TOK_EOF, TOK_ERROR
 } TokenType;
 
-// Token structure
+// Token structure. The text is a slice of the source (not terminated);
+// error tokens point at their message instead.
 typedef struct {
     TokenType type;
-    char* value;
+    const char* start;
+    size_t length;
     int line;
 } Token;
 
@@ -34,53 +37,183 @@ typedef struct {
 typedef enum {
     AST_PROGRAM, AST_ASSIGN, AST_BINOP, AST_UNARYOP, AST_NUMBER, AST_STRING,
     AST_BOOLEAN, AST_NULL, AST_VAR, AST_LIST, AST_CALL, AST_IF, AST_LOOP, AST_INDEX,
-    AST_EACH, AST_FUNCDEF, AST_RETURN, AST_BREAK, AST_CONTINUE, AST_EXPRSTMT
+    AST_EACH, AST_FUNCDEF, AST_RETURN, AST_BREAK, AST_CONTINUE, AST_EXPRSTMT, AST_DICT,
+    AST_RANGE     // only a value type: ranges are made by the range() built-in
 } ASTType;
 
+// Interned identifier (atom.c). Equal names are the same pointer.
+typedef const char* Atom;
+
+// Hash map from atoms to non-negative ints (function and builtin indices)
+typedef struct {
+    Atom* keys;           // NULL marks an empty slot
+    int* values;
+    int count;
+    int capacity;
+} AtomMap;
+
+// Operators of AST_BINOP and AST_UNARYOP nodes
+typedef enum {
+    BINOP_ADD, BINOP_SUB, BINOP_MUL, BINOP_DIV,    // arithmetic first
+    BINOP_EQ, BINOP_NEQ, BINOP_LT, BINOP_LE, BINOP_GT, BINOP_GE
+} BinaryOp;
+
+typedef enum {
+    UNOP_NEGATE
+} UnaryOp;
+
+extern const char* const binop_names[];
+
+// Counters of a binary operation that specialized itself (see quicken.c).
+// Sites are only kept with --quicken-stats.
+typedef struct {
+    int index;                 // into quick_sites; the VM's operand for the site
+    int line;
+    BinaryOp op;
+    const char* form;          // the specialized form, NULL until it first ran
+    unsigned long hits;        // runs of the specialized form
+    unsigned long misses;      // operands that sent it back to the generic form
+} QuickSite;
+
+// Operand of a VM comparison when no site is kept: whether its fused form
+// has ever seen an operand that was not a number
+enum { QUICK_NO_SITE = -1, QUICK_MISSED = -2 };
+
+// How a tree-walker binop evaluates its operands
+typedef enum {
+    QUICK_NONE,                // not run yet
+    QUICK_GENERIC,             // through evaluate
+    QUICK_DIRECT               // both are variables or literals that held numbers
+} QuickForm;
+
 // Forward declarations
 typedef struct ASTNode ASTNode;
 typedef struct MASObject MASObject;
 
-// MAS Object system (for GC foundation)
+// Values are NaN-boxed into 64 bits. Any double that is not a quiet NaN
+// with the bits below set is a number; null, booleans and heap object
+// pointers are encoded in the unused NaN payload space.
+typedef uint64_t Value;
+
+#define SIGN_BIT  ((uint64_t)0x8000000000000000)
+#define QNAN      ((uint64_t)0x7ffc000000000000)
+#define TAG_NULL  1
+#define TAG_FALSE 2
+#define TAG_TRUE  3
+
+#define NULL_VAL        ((Value)(QNAN | TAG_NULL))
+#define FALSE_VAL       ((Value)(QNAN | TAG_FALSE))
+#define TRUE_VAL        ((Value)(QNAN | TAG_TRUE))
+#define BOOL_VAL(b)     ((b) ? TRUE_VAL : FALSE_VAL)
+#define NUMBER_VAL(n)   number_to_value(n)
+#define OBJ_VAL(obj)    ((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj)))
+
+#define IS_NUMBER(v)    (((v) & QNAN) != QNAN)
+#define IS_NULL(v)      ((v) == NULL_VAL)
+#define IS_BOOL(v)      (((v) | 1) == TRUE_VAL)
+#define IS_OBJ(v)       (((v) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+
+#define AS_NUMBER(v)    value_to_number(v)
+#define AS_BOOL(v)      ((v) == TRUE_VAL)
+#define AS_OBJ(v)       ((MASObject*)(uintptr_t)((v) & ~(SIGN_BIT | QNAN)))
+
+static inline Value number_to_value(double number) {
+    Value value;
+    memcpy(&value, &number, sizeof(double));
+    return value;
+}
+
+static inline double value_to_number(Value value) {
+    double number;
+    memcpy(&number, &value, sizeof(Value));
+    return number;
+}
+
+// A dictionary slot; the key is null when the slot is empty
+typedef struct DictEntry DictEntry;
+
+// MAS Object system: strings, lists, dictionaries and ranges live on the heap
 typedef struct MASObject {
     ASTType type;
     bool marked;              // for GC
+    bool young;               // lives in the nursery
+    bool remembered;          // old object in the GC's remembered set
+    bool forwarded;           // young object already promoted to data.forward
     union {
-        double number;
-        char* string;
-        bool boolean;
         struct {
-            struct MASObject** items;
+            char* string;
+            uint32_t hash;        // 0 until the string is first hashed
+        };
+        struct {
+            Value* items;
             int count;
+            int capacity;
         } list;
+        struct {
+            DictEntry* entries;
+            int count;
+            int capacity;         // a power of two, or 0 before the first insert
+        } dict;
+        struct {
+            int start;
+            int end;              // inclusive, like 'each i in start to end'
+            int step;             // never 0
+        } range;
+        struct MASObject* forward;
     } data;
 }MASObject;
 
+struct DictEntry {
+    Value key;
+    Value value;
+};
+
+#define IS_STRING(v)    (IS_OBJ(v) && AS_OBJ(v)->type == AST_STRING)
+#define IS_LIST(v)      (IS_OBJ(v) && AS_OBJ(v)->type == AST_LIST)
+#define IS_DICT(v)      (IS_OBJ(v) && AS_OBJ(v)->type == AST_DICT)
+#define IS_RANGE(v)     (IS_OBJ(v) && AS_OBJ(v)->type == AST_RANGE)
+#define AS_STRING(v)    (AS_OBJ(v)->data.string)
+
+// The AST type a value would be written as (AST_NUMBER, AST_LIST, ...)
+static inline ASTType value_type(Value value) {
+    if (IS_NUMBER(value)) return AST_NUMBER;
+    if (IS_OBJ(value)) return AS_OBJ(value)->type;
+    if (IS_NULL(value)) return AST_NULL;
+    return AST_BOOLEAN;
+}
+
 // AST Node structure
 struct ASTNode {
     ASTType type;
     int line;
     union {
-        struct { char* name; ASTNode* value; ASTNode* index; } assign;
-        struct { ASTNode* left; char* op; ASTNode* right; } binop;
-        struct { char* op; ASTNode* operand; } unaryop;
+        // slot/global on variable references are filled in by the resolver
+        struct { Atom name; ASTNode* value; ASTNode* index; int slot; bool global; } assign;
+        struct { ASTNode* left; BinaryOp op; ASTNode* right; QuickForm quick; QuickSite* site; } binop;
+        struct { UnaryOp op; ASTNode* operand; } unaryop;
         double number;
         char* string;
         bool boolean;
-        char* var_name;
+        struct { Atom name; int slot; bool global; } var;
         struct { ASTNode** items; int count; } list;
-        struct { char* name; ASTNode** args; int arg_count; } call;
+        struct { ASTNode** keys; ASTNode** values; int count; } dict;
+        // builtin is bound by the resolver (-1 for user functions); function
+        // caches the definition the call found the first time it ran; tail
+        // marks 'give f(...)' inside a function, which reuses the caller's frame
+        struct { Atom name; ASTNode** args; int arg_count; int builtin; ASTNode* function; bool tail; } call;
         struct { ASTNode* condition; ASTNode** body; int body_count; } loop;
         struct { 
-            char* target; 
+            Atom target; 
             ASTNode* iterable;      // for lists
             ASTNode* range_start;   // for ranges (if not NULL)
             ASTNode* range_end;     // for ranges
             ASTNode** body; 
             int body_count; 
+            int slot;
+            bool global;
         } each;
-        struct { char* target; ASTNode* index; } index;  // ← for AST_INDEX
-        struct { char* name; char** params; int param_count; ASTNode** body; int body_count; } funcdef;
+        struct { Atom target; ASTNode* index; int slot; bool global; } index;  // ← for AST_INDEX
+        struct { Atom name; Atom* params; int param_count; ASTNode** body; int body_count; int local_count; } funcdef;
         struct { ASTNode* condition; ASTNode** then_body; int then_body_count; ASTNode** else_body; int else_body_count; } if_stmt;
         ASTNode* expr;
     } data;
@@ -94,12 +227,261 @@ typedef enum {
 
 extern ExecutionMode mode;
 
+// Command line options
+typedef struct {
+    bool ast_interp;   // --ast-interp: run the tree-walking evaluator instead of the VM
+    bool dump_ast;     // --dump-ast: print the optimized AST instead of running it
+    bool quicken_stats; // --quicken-stats: print specialized operation counters at exit
+    bool jit;          // --jit: compile hot bytecode to native code
+    int jit_threshold; // --jit-threshold=N: entries (calls or loop iterations) before compiling
+    bool stream;       // --stream: parse, run and free one top-level statement at a time
+} Options;
+
+extern Options options;
+
+typedef struct VM VM;
+
+// Interpreter state shared by the tree walker, the VM and the built-ins
+typedef struct Interpreter {
+    Value *globals;            // indexed by the slots the resolver hands out
+    int global_count;
+    Value *locals;             // tree walker: slots of the running function (frames + frame_base)
+    Value *frames;             // tree walker: slots of every active call, innermost last
+    int frame_base;
+    int frame_top;
+    int frame_capacity;
+    Value return_value;        // tree walker: value of the 'give' being unwound
+    ASTNode *tail_function;    // tree walker: callee of the tail call being unwound
+    int loop_depth;            // tree walker: loops around the statement running in this call
+    int call_depth;
+    Value *roots;              // tree walker: temporaries not stored anywhere yet
+    int root_count;
+    int root_capacity;
+    struct {
+        AtomMap names;         // name -> index into funcs
+        ASTNode** funcs;
+        int count;
+        int capacity;
+    } functions;
+    VM *vm;            // set while running bytecode; its stack and frames are GC roots
+} Interpreter;
+
+typedef Value (*BuiltinFn)(Interpreter *interp, Value *args, int arg_count);
+
+typedef struct {
+    const char *name;
+    BuiltinFn fn;
+} Builtin;
+
+extern const Builtin builtins[];
+
+// Bytecode instruction set. Every instruction is one int followed by its
+// int operands (listed in the comment next to each opcode).
+#define OPCODE_LIST(X) \
+    X(CONSTANT)      /* k: push constants[k] */ \
+    X(STRING)        /* k: push a copy of the string constants[k] */ \
+    X(NULL)          /* push null */ \
+    X(TRUE)          /* push true */ \
+    X(FALSE)         /* push false */ \
+    X(POP)           /* discard top */ \
+    X(GET_LOCAL)     /* slot: push a local of the current frame */ \
+    X(SET_LOCAL)     /* slot: store top into a local, keep it */ \
+    X(GET_GLOBAL)    /* slot: push a global */ \
+    X(SET_GLOBAL)    /* slot: store top into a global, keep it */ \
+    X(GET_INDEX)     /* k: pop index and list or dict, push list[index] */ \
+    X(SET_INDEX)     /* k: pop index and list or dict, store top into list[index] */ \
+    X(ADD) X(SUB) X(MUL) X(DIV) \
+    X(EQ) X(NEQ) X(LT) X(LE) X(GT) X(GE) /* site: compare the top two */ \
+    X(EQ_JUMP) X(NEQ_JUMP) X(LT_JUMP)    /* site: quickened compare fused with the */ \
+    X(LE_JUMP) X(GT_JUMP) X(GE_JUMP)     /*   JUMP_IF_FALSE that follows it */ \
+    X(NEGATE) \
+    X(LIST)          /* n: pop n items, push a new list */ \
+    X(DICT)          /* n: pop n key/value pairs, push a new dict */ \
+    X(JUMP)          /* target */ \
+    X(JUMP_IF_FALSE) /* target, what: pop a boolean condition */ \
+    X(RANGE_INIT)    /* check the two range bounds on top */ \
+    X(RANGE_NEXT)    /* scope, slot, exit: advance counter below the end bound */ \
+    X(LIST_INIT)     /* check the list, dict or range on top, push an index counter */ \
+    X(LIST_NEXT)     /* scope, slot, exit: bind next item (or key) or jump out */ \
+    X(CALL)          /* k, argc: look up the function named constants[k], rewrite to CALL_FUNCTION */ \
+    X(CALL_FUNCTION) /* index, argc: call the index-th defined function */ \
+    X(TAIL_CALL)     /* k, argc: like CALL, rewrites to TAIL_CALL_FUNCTION */ \
+    X(TAIL_CALL_FUNCTION) /* index, argc: run the function in the current frame */ \
+    X(CALL_BUILTIN)  /* index, argc: call builtins[index] */ \
+    X(DEF)           /* index: register chunk->functions[index] */ \
+    X(RETURN)        /* return top to the caller */ \
+    X(HALT)
+
+typedef enum {
+#define X(name) OP_##name,
+    OPCODE_LIST(X)
+#undef X
+    OP_COUNT
+} OpCode;
+
+// Condition kinds for OP_JUMP_IF_FALSE (they only differ in the error message)
+enum { COND_IF, COND_LOOP };
+
+// Variable scopes for the loop instructions that bind a variable
+enum { SCOPE_LOCAL, SCOPE_GLOBAL };
+
+typedef struct FunctionProto FunctionProto;
+typedef struct JitCode JitCode;
+
+// Compiled code for the program or for one function body
+typedef struct {
+    int *code;
+    int *lines;
+    int count;
+    int capacity;
+    Value *constants;
+    int constant_count;
+    int constant_capacity;
+    FunctionProto **functions;
+    int function_count;
+    int function_capacity;
+    int max_stack;            // deepest operand stack the code can reach
+    int hotness;              // --jit: entries so far, -1 if it cannot be compiled
+    JitCode *jit;             // --jit: native code, once hot
+} Chunk;
+
+struct FunctionProto {
+    Atom name;
+    Atom *params;
+    int param_count;
+    int local_count;          // parameters first, then the other locals
+    Chunk chunk;
+};
+
 // Function declarations
+// Bump allocator for data released all at once (arena.c)
+typedef struct ArenaBlock ArenaBlock;
+typedef struct {
+    ArenaBlock* blocks;           // newest first
+} Arena;
+void* arena_alloc(Arena* arena, size_t size);
+void arena_move(Arena* to, Arena* from);
+void arena_free(Arena* arena);
+
 void lexer_init(FILE* f);
 void lexer_init_repl(char* code);
-Token* lexer_next();
+Token lexer_next();
+void lexer_release_consumed();
+double token_number(const Token* tok);
+void token_string(const Token* tok, char* value);
+
+// The nodes, child arrays and string literals of the parsed program live in
+// ast_arena; free it once the program has run
+extern Arena ast_arena;
+ASTNode** ast_copy_nodes(ASTNode** nodes, int count);
 ASTNode* parse_program();
-MASObject* interpret(ASTNode* ast);
+ASTNode* parse_next_statement(bool* defines_function);
+Value interpret(ASTNode* ast);
+// A program can also run in parts on one interpreter, which keeps globals
+// and functions from one part to the next (--stream)
+void interpret_begin(void);
+Value interpret_next(ASTNode* program);
+void interpret_end(void);
+void interpreter_reserve_globals(Interpreter* interp);
 void print_ast(ASTNode* node, int indent);
 
+// Atom table (atom.c)
+Atom atom_intern(const char* name);
+Atom atom_intern_length(const char* name, size_t length);
+int atom_map_get(const AtomMap* map, Atom key);   // -1 if absent
+void atom_map_set(AtomMap* map, Atom key, int value);
+void atom_map_free(AtomMap* map);
+
+// Template JIT for the VM (jit.c)
+bool jit_supported(void);
+bool jit_hot(Chunk* chunk);
+JitCode* jit_compile(Chunk* chunk);
+void jit_free(JitCode* jit);
+int* jit_run(Chunk* chunk, int* ip, Value** sp, Value* slots, Value* globals);
+
+// Quickened operation sites (quicken.c)
+extern QuickSite** quick_sites;
+extern int quick_site_count;
+QuickSite* quick_site_new(int line, BinaryOp op);
+void quick_print_stats(void);
+
+// Resolver (resolver.c): binds every variable to a local slot or a global
+void resolve_program(ASTNode* program);
+int resolver_global_count();
+
+// Optimizer (optimizer.c): folds constants and prunes dead code; run after
+// the resolver
+void optimize_program(ASTNode* program);
+
+// Runtime (interpreter.c)
+Value create_string(const char *value);
+Value create_list(Value *items, int count);
+Value create_range(int start, int end, int step);
+int range_length(MASObject *range);
+Value create_constant(ASTNode *literal);
+int find_builtin(Atom name);
+
+// Garbage collector (gc.c)
+typedef struct {
+    size_t threshold;          // old space size that triggers the first major collection
+    double growth;             // next threshold = live bytes after a collection * growth
+    size_t nursery;            // size of the young generation in bytes
+    long max_pause_us;         // > 0: collect the old space incrementally within this budget
+    bool stress;               // collect before every allocation (for debugging roots)
+    bool stats;                // print collector statistics at exit
+} GCConfig;
+
+extern GCConfig gc_config;
+extern bool gc_marking;
+
+void gc_config_from_env();
+void gc_set_interpreter(Interpreter* interp);
+MASObject* allocate_object(ASTType type, size_t payload);
+void gc_visit_roots(Value* slots, int count);
+void gc_remember(MASObject* obj);
+void gc_shade(MASObject* obj);
+void gc_reserve_list(MASObject* list, int capacity);
+void* gc_alloc_payload(MASObject* obj, size_t size);
+void gc_free_payload(void* payload, size_t size);
+void gc_collect(Interpreter* interp, bool verbose);
+void gc_print_stats();
+
+// Dictionaries (dict.c)
+Value create_dict(int expected);
+uint32_t string_hash(MASObject* string);
+void dict_check_key(Value key);
+bool dict_get(MASObject* dict, Value key, Value* value);
+void dict_set(MASObject* dict, Value key, Value value);
+bool dict_delete(MASObject* dict, Value key);
+int dict_next(MASObject* dict, int index);
+
+// Slab allocator for old-space objects (slab.c)
+MASObject* slab_alloc_object();
+void slab_free_object(MASObject* obj);
+void* slab_alloc(size_t size);
+void slab_free(void* ptr, size_t size);
+void slab_print_stats();
+
+// Call after storing 'value' into 'owner'. Old objects that point into the
+// nursery are remembered so that minor collections treat them as roots, and
+// while an incremental collection is marking, stored objects are shaded gray.
+static inline void gc_write_barrier(MASObject* owner, Value value) {
+    if (owner->young || !IS_OBJ(value)) return;
+    MASObject* target = AS_OBJ(value);
+    if (target->young) {
+        if (!owner->remembered) gc_remember(owner);
+    } else if (gc_marking && !target->marked) {
+        gc_shade(target);
+    }
+}
+
+// Bytecode compiler (compiler.c) and virtual machine (vm.c)
+Chunk* compile_program(ASTNode* program);
+void free_chunk(Chunk* chunk);
+Value vm_interpret(ASTNode* ast);
+void vm_begin(void);
+Value vm_next(ASTNode* program);
+void vm_end(void);
+void vm_mark_roots(VM* vm);
+
 #endif
\ No newline at end of file
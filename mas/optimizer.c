@@ -0,0 +1,258 @@
+// optimizer.c
+#include "mas.h"
+
+// Simplifies the AST after the resolver has bound every variable:
+//   - operators over number literals are folded (comparisons become booleans)
+//   - x * 1, 1 * x, x / 1 and x - 0 become x when x is known to be a number
+//   - an if with a literal true or false condition is replaced by its branch
+//   - a loop whose condition is the literal false is dropped
+//   - expression statements without side effects are dropped
+// Anything that would fail at run time (a type error, division by zero) is
+// left alone so the error still happens when and where it did before.
+// Running after the resolver keeps pruned assignments from changing which
+// names are locals.
+
+static ASTNode* optimize_node(ASTNode* node);
+
+static bool is_number(ASTNode* node) {
+    return node->type == AST_NUMBER;
+}
+
+// Whether evaluating the node always yields a number (or fails on its own)
+static bool yields_number(ASTNode* node) {
+    switch (node->type) {
+    case AST_NUMBER:
+    case AST_UNARYOP:
+        return true;
+    case AST_BINOP:
+        return node->data.binop.op <= BINOP_DIV;
+    default:
+        return false;
+    }
+}
+
+static bool is_number_literal(ASTNode* node, double value) {
+    return is_number(node) && node->data.number == value;
+}
+
+static ASTNode* fold_binop(ASTNode* node) {
+    ASTNode* left = node->data.binop.left;
+    ASTNode* right = node->data.binop.right;
+
+    if (is_number(left) && is_number(right)) {
+        double l = left->data.number;
+        double r = right->data.number;
+        double number;
+        bool boolean;
+        switch (node->data.binop.op) {
+        case BINOP_ADD: number = l + r; goto folded_number;
+        case BINOP_SUB: number = l - r; goto folded_number;
+        case BINOP_MUL: number = l * r; goto folded_number;
+        case BINOP_DIV:
+            if (r == 0) return node;       // keep the run-time error
+            number = l / r;
+            goto folded_number;
+        case BINOP_EQ:  boolean = l == r; goto folded_boolean;
+        case BINOP_NEQ: boolean = l != r; goto folded_boolean;
+        case BINOP_LT:  boolean = l < r; goto folded_boolean;
+        case BINOP_LE:  boolean = l <= r; goto folded_boolean;
+        case BINOP_GT:  boolean = l > r; goto folded_boolean;
+        case BINOP_GE:  boolean = l >= r; goto folded_boolean;
+        }
+        return node;
+    folded_number:
+        node->type = AST_NUMBER;
+        node->data.number = number;
+        return node;
+    folded_boolean:
+        node->type = AST_BOOLEAN;
+        node->data.boolean = boolean;
+        return node;
+    }
+
+    // Identities that hold for every number. x + 0 is not one of them:
+    // -0 + 0 is 0.
+    switch (node->data.binop.op) {
+    case BINOP_MUL:
+        if (is_number_literal(right, 1) && yields_number(left)) return left;
+        if (is_number_literal(left, 1) && yields_number(right)) return right;
+        break;
+    case BINOP_DIV:
+        if (is_number_literal(right, 1) && yields_number(left)) return left;
+        break;
+    case BINOP_SUB:
+        if (is_number_literal(right, 0) && yields_number(left)) return left;
+        break;
+    default:
+        break;
+    }
+    return node;
+}
+
+static ASTNode* fold_unaryop(ASTNode* node) {
+    ASTNode* operand = node->data.unaryop.operand;
+    if (is_number(operand)) {
+        node->type = AST_NUMBER;
+        node->data.number = -operand->data.number;
+    } else if (operand->type == AST_UNARYOP && yields_number(operand->data.unaryop.operand)) {
+        // - -x is x
+        return operand->data.unaryop.operand;
+    }
+    return node;
+}
+
+// Whether evaluating the expression can neither fail nor have an effect
+static bool is_pure(ASTNode* node) {
+    switch (node->type) {
+    case AST_NUMBER:
+    case AST_STRING:
+    case AST_BOOLEAN:
+    case AST_NULL:
+    case AST_VAR:
+        return true;
+    case AST_LIST:
+        for (int i = 0; i < node->data.list.count; i++) {
+            if (!is_pure(node->data.list.items[i])) return false;
+        }
+        return true;
+    case AST_DICT:
+        for (int i = 0; i < node->data.dict.count; i++) {
+            ASTNode* key = node->data.dict.keys[i];
+            if (key->type != AST_NUMBER && key->type != AST_STRING) return false;
+            if (!is_pure(node->data.dict.values[i])) return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Statements are collected into a scratch array so that a pruned 'if' can
+// be replaced by any number of statements from its branch; the result is
+// copied into the AST arena
+typedef struct {
+    ASTNode** items;
+    int count;
+    int capacity;
+} Block;
+
+static void block_add(Block* block, ASTNode* stmt) {
+    if (block->count >= block->capacity) {
+        block->capacity = block->capacity ? block->capacity * 2 : 8;
+        block->items = realloc(block->items, sizeof(ASTNode*) * block->capacity);
+    }
+    block->items[block->count++] = stmt;
+}
+
+static void optimize_into(Block* block, ASTNode** body, int count);
+
+static void optimize_statement(Block* block, ASTNode* stmt) {
+    stmt = optimize_node(stmt);
+
+    switch (stmt->type) {
+    case AST_EXPRSTMT:
+        if (is_pure(stmt->data.expr)) return;
+        break;
+    case AST_IF: {
+        ASTNode* cond = stmt->data.if_stmt.condition;
+        if (cond->type != AST_BOOLEAN) break;
+        if (cond->data.boolean) {
+            optimize_into(block, stmt->data.if_stmt.then_body, stmt->data.if_stmt.then_body_count);
+        } else if (stmt->data.if_stmt.else_body) {
+            optimize_into(block, stmt->data.if_stmt.else_body, stmt->data.if_stmt.else_body_count);
+        }
+        return;
+    }
+    case AST_LOOP:
+        if (stmt->data.loop.condition->type == AST_BOOLEAN && !stmt->data.loop.condition->data.boolean) return;
+        break;
+    default:
+        break;
+    }
+    block_add(block, stmt);
+}
+
+static void optimize_into(Block* block, ASTNode** body, int count) {
+    for (int i = 0; i < count; i++) {
+        optimize_statement(block, body[i]);
+    }
+}
+
+static void optimize_block(ASTNode*** body, int* count) {
+    Block block = {0};
+    optimize_into(&block, *body, *count);
+    *body = ast_copy_nodes(block.items, block.count);
+    *count = block.count;
+    free(block.items);
+}
+
+static void optimize_list(ASTNode** items, int count) {
+    for (int i = 0; i < count; i++) {
+        items[i] = optimize_node(items[i]);
+    }
+}
+
+static ASTNode* optimize_node(ASTNode* node) {
+    if (!node) return NULL;
+
+    switch (node->type) {
+    case AST_PROGRAM:
+        optimize_block(&node->data.list.items, &node->data.list.count);
+        break;
+    case AST_BINOP:
+        node->data.binop.left = optimize_node(node->data.binop.left);
+        node->data.binop.right = optimize_node(node->data.binop.right);
+        return fold_binop(node);
+    case AST_UNARYOP:
+        node->data.unaryop.operand = optimize_node(node->data.unaryop.operand);
+        return fold_unaryop(node);
+    case AST_ASSIGN:
+        node->data.assign.value = optimize_node(node->data.assign.value);
+        node->data.assign.index = optimize_node(node->data.assign.index);
+        break;
+    case AST_INDEX:
+        node->data.index.index = optimize_node(node->data.index.index);
+        break;
+    case AST_LIST:
+        optimize_list(node->data.list.items, node->data.list.count);
+        break;
+    case AST_DICT:
+        optimize_list(node->data.dict.keys, node->data.dict.count);
+        optimize_list(node->data.dict.values, node->data.dict.count);
+        break;
+    case AST_CALL:
+        optimize_list(node->data.call.args, node->data.call.arg_count);
+        break;
+    case AST_IF:
+        node->data.if_stmt.condition = optimize_node(node->data.if_stmt.condition);
+        optimize_block(&node->data.if_stmt.then_body, &node->data.if_stmt.then_body_count);
+        if (node->data.if_stmt.else_body) {
+            optimize_block(&node->data.if_stmt.else_body, &node->data.if_stmt.else_body_count);
+        }
+        break;
+    case AST_LOOP:
+        node->data.loop.condition = optimize_node(node->data.loop.condition);
+        optimize_block(&node->data.loop.body, &node->data.loop.body_count);
+        break;
+    case AST_EACH:
+        node->data.each.iterable = optimize_node(node->data.each.iterable);
+        node->data.each.range_start = optimize_node(node->data.each.range_start);
+        node->data.each.range_end = optimize_node(node->data.each.range_end);
+        optimize_block(&node->data.each.body, &node->data.each.body_count);
+        break;
+    case AST_FUNCDEF:
+        optimize_block(&node->data.funcdef.body, &node->data.funcdef.body_count);
+        break;
+    case AST_EXPRSTMT:
+    case AST_RETURN:
+        node->data.expr = optimize_node(node->data.expr);
+        break;
+    default:
+        break;
+    }
+    return node;
+}
+
+void optimize_program(ASTNode* program) {
+    optimize_node(program);
+}
@@ -1,15 +1,18 @@
 // parser.c
 #include "mas.h"
+#include <stddef.h>
 
+static Token token;
 static Token* current_token = NULL; // The token we are currently looking at
 
 static void advance() {
-    // Free the old token if it exists
-    if (current_token && current_token->type != TOK_EOF) {
-        if (current_token->value) free(current_token->value);
-        free(current_token);
-    }
-    current_token = lexer_next();
+    token = lexer_next();
+    current_token = &token;
+}
+
+// The atom naming the current identifier token
+static Atom token_atom() {
+    return atom_intern_length(current_token->start, current_token->length);
 }
 
 static bool match(TokenType type) {
@@ -28,6 +31,63 @@ static void consume(TokenType type, const char* message) {
     advance();
 }
 
+Arena ast_arena;
+
+#define NODE_SIZE(member) (offsetof(ASTNode, data) + sizeof(((ASTNode*)0)->data.member))
+#define HEADER_SIZE offsetof(ASTNode, data)
+
+// A node takes the header and its own member of the union, not the largest
+// one. The optimizer may turn an operator into the literal it folds to,
+// which is never bigger.
+static const size_t node_sizes[] = {
+    [AST_PROGRAM] = NODE_SIZE(list), [AST_ASSIGN] = NODE_SIZE(assign),
+    [AST_BINOP] = NODE_SIZE(binop), [AST_UNARYOP] = NODE_SIZE(unaryop),
+    [AST_NUMBER] = NODE_SIZE(number), [AST_STRING] = NODE_SIZE(string),
+    [AST_BOOLEAN] = NODE_SIZE(boolean), [AST_NULL] = HEADER_SIZE,
+    [AST_VAR] = NODE_SIZE(var), [AST_LIST] = NODE_SIZE(list),
+    [AST_CALL] = NODE_SIZE(call), [AST_IF] = NODE_SIZE(if_stmt),
+    [AST_LOOP] = NODE_SIZE(loop), [AST_INDEX] = NODE_SIZE(index),
+    [AST_EACH] = NODE_SIZE(each), [AST_FUNCDEF] = NODE_SIZE(funcdef),
+    [AST_RETURN] = NODE_SIZE(expr), [AST_BREAK] = HEADER_SIZE,
+    [AST_CONTINUE] = HEADER_SIZE, [AST_EXPRSTMT] = NODE_SIZE(expr),
+    [AST_DICT] = NODE_SIZE(dict),
+};
+
+static ASTNode* new_node(ASTType type) {
+    ASTNode* node = arena_alloc(&ast_arena, node_sizes[type]);
+    node->type = type;
+    return node;
+}
+
+ASTNode** ast_copy_nodes(ASTNode** nodes, int count) {
+    ASTNode** copy = arena_alloc(&ast_arena, sizeof(ASTNode*) * count);
+    if (count > 0) memcpy(copy, nodes, sizeof(ASTNode*) * count); // nodes may be NULL
+    return copy;
+}
+
+// Child lists of any length are collected on one growable stack. A list
+// nested in another is pushed above the part of its parent parsed so far
+// and taken off before the parent goes on, and each finished list is
+// copied into the arena at its final size.
+static ASTNode** scratch = NULL;
+static int scratch_count = 0;
+static int scratch_capacity = 0;
+
+static void scratch_push(ASTNode* node) {
+    if (scratch_count >= scratch_capacity) {
+        scratch_capacity = scratch_capacity ? scratch_capacity * 2 : 256;
+        scratch = realloc(scratch, sizeof(ASTNode*) * scratch_capacity);
+    }
+    scratch[scratch_count++] = node;
+}
+
+// The nodes pushed since 'base', moved into the arena
+static ASTNode** scratch_take(int base) {
+    ASTNode** nodes = ast_copy_nodes(scratch + base, scratch_count - base);
+    scratch_count = base;
+    return nodes;
+}
+
 // Forward declarations for recursive parsing
 ASTNode* parse_statement();
 ASTNode* parse_expression();
@@ -37,35 +97,76 @@ ASTNode* parse_factor();
 ASTNode* parse_unary();
 ASTNode* parse_primary();
 
+// Parses statements up to 'end' (or up to 'else' when stop_at_else is set)
+static ASTNode** parse_block(bool stop_at_else, int* count) {
+    int base = scratch_count;
+    while (current_token && current_token->type != TOK_END &&
+           !(stop_at_else && current_token->type == KW_ELSE)) {
+        if (current_token->type == TOK_NEWLINE) {
+            advance();
+            continue;
+        }
+        scratch_push(parse_statement());
+    }
+    *count = scratch_count - base;
+    return scratch_take(base);
+}
+
+// Set when a 'def' is parsed, anywhere in a statement
+static bool parsed_function = false;
+
+// The next top-level statement, or NULL at EOF
+static ASTNode* parse_top_level() {
+    while (current_token && current_token->type == TOK_NEWLINE) {
+        advance();
+    }
+    if (!current_token || current_token->type == TOK_EOF) return NULL;
+
+    ASTNode* stmt = parse_statement();
+
+    // After a statement, we must have a newline or EOF.
+    if (current_token->type == TOK_EOF ) {
+        advance();
+    }
+    else if (current_token->type != TOK_EOF ) {
+        consume(TOK_NEWLINE, "Expected newline after statement");
+    }
+    return stmt;
+}
+
 // Parse program
 ASTNode* parse_program() {
-    ASTNode* program = malloc(sizeof(ASTNode));
-    program->type = AST_PROGRAM;
+    ASTNode* program = new_node(AST_PROGRAM);
     program->line = 1;
     
     // Parse statements until EOF
-    int stmt_count = 0;
-    ASTNode** statements = malloc(sizeof(ASTNode*) * 100); // TODO: dynamic resize
+    int base = scratch_count;
     
     advance(); // get first token
-    while (current_token && current_token->type != TOK_EOF) {
-        if (current_token->type == TOK_NEWLINE) {
-            advance();
-            continue;
-        }
-        statements[stmt_count++] = parse_statement();
-
-        // After a statement, we must have a newline or EOF.
-        if (current_token->type == TOK_EOF ) {
-            advance();
-        }
-        else if (current_token->type != TOK_EOF ) {
-            consume(TOK_NEWLINE, "Expected newline after statement");
-        }
+    ASTNode* stmt;
+    while ((stmt = parse_top_level())) {
+        scratch_push(stmt);
     }
     
-    program->data.list.items = statements;
-    program->data.list.count = stmt_count;
+    program->data.list.count = scratch_count - base;
+    program->data.list.items = scratch_take(base);
+    return program;
+}
+
+// For --stream: the next top-level statement as a program of its own, or
+// NULL at EOF. defines_function is set if the statement contains a 'def',
+// whose nodes the running program goes on using after the statement ends.
+ASTNode* parse_next_statement(bool* defines_function) {
+    if (!current_token) advance(); // get first token
+    parsed_function = false;
+    ASTNode* stmt = parse_top_level();
+    if (!stmt) return NULL;
+    *defines_function = parsed_function;
+
+    ASTNode* program = new_node(AST_PROGRAM);
+    program->line = stmt->line;
+    program->data.list.items = ast_copy_nodes(&stmt, 1);
+    program->data.list.count = 1;
     return program;
 }
 
@@ -73,6 +174,7 @@ ASTNode* parse_program() {
 ASTNode* parse_statement() {
     int start_line = current_token->line;
     if (match(KW_DEF)) {
+    parsed_function = true;
     advance(); // consume 'def'
     
     if (!match(TOK_ID)) {
@@ -80,13 +182,14 @@ ASTNode* parse_statement() {
         fprintf(stderr, "Expected function name\n");
         exit(1);
     }
-    char* func_name = strdup(current_token->value);
+    Atom func_name = token_atom();
     advance(); // consume function name
 
     consume(TOK_LPAREN, "Expected '('");
     
-    char** params = malloc(sizeof(char*) * 10);
+    Atom* params = NULL;
     int param_count = 0;
+    int param_capacity = 0;
     
     if (!match(TOK_RPAREN)) {
         do {
@@ -95,7 +198,11 @@ ASTNode* parse_statement() {
                 fprintf(stderr,"Expected parameter name\n");
                 exit(1);
             }
-            params[param_count++] = strdup(current_token->value);
+            if (param_count >= param_capacity) {
+                param_capacity = param_capacity ? param_capacity * 2 : 8;
+                params = realloc(params, sizeof(Atom) * param_capacity);
+            }
+            params[param_count++] = token_atom();
             advance(); // consume parameter name
         } while (match(TOK_COMMA) && (advance(), 1)); // consume comma
     }
@@ -105,22 +212,16 @@ ASTNode* parse_statement() {
     consume(TOK_NEWLINE, "Expected newline after function header");
     
     // Parse function body
-    int body_count = 0;
-    ASTNode** body = malloc(sizeof(ASTNode*) * 100);
-    while (current_token && current_token->type != TOK_END) {
-        if (current_token->type == TOK_NEWLINE) {
-            advance();
-            continue;
-        }
-        body[body_count++] = parse_statement();
-    }
+    int body_count;
+    ASTNode** body = parse_block(false, &body_count);
     consume(TOK_END, "Expected 'end' to close function");
     
-    ASTNode* func = malloc(sizeof(ASTNode));
-    func->type = AST_FUNCDEF;
+    ASTNode* func = new_node(AST_FUNCDEF);
     func->line = start_line;
     func->data.funcdef.name = func_name;
-    func->data.funcdef.params = params;
+    func->data.funcdef.params = arena_alloc(&ast_arena, sizeof(Atom) * param_count);
+    if (param_count > 0) memcpy(func->data.funcdef.params, params, sizeof(Atom) * param_count);
+    free(params);
     func->data.funcdef.param_count = param_count;
     func->data.funcdef.body = body;
     func->data.funcdef.body_count = body_count;
@@ -133,19 +234,11 @@ ASTNode* parse_statement() {
         consume(TOK_COLON, "Expected ':'");
         consume(TOK_NEWLINE, "Expected newline after loop condition");
         
-        int body_count = 0;
-        ASTNode** body = malloc(sizeof(ASTNode*) * 100);
-        while (current_token && current_token->type != TOK_END) {
-            if (current_token->type == TOK_NEWLINE) {
-                advance();
-                continue;
-            }
-            body[body_count++] = parse_statement();
-        }
+        int body_count;
+        ASTNode** body = parse_block(false, &body_count);
         consume(TOK_END, "Expected 'end' to close loop");
         
-        ASTNode* loop = malloc(sizeof(ASTNode));
-        loop->type = AST_LOOP;
+        ASTNode* loop = new_node(AST_LOOP);
         loop->line = loop_line;
         loop->data.loop.condition = condition;
         loop->data.loop.body = body;
@@ -161,7 +254,7 @@ ASTNode* parse_statement() {
         fprintf(stderr, "Expected variable name\n");
         exit(1);
     }
-    char* target = strdup(current_token->value);
+    Atom target = token_atom();
     advance(); // consume identifier
 
     consume(KW_IN, "Expected 'in'");
@@ -189,19 +282,11 @@ ASTNode* parse_statement() {
     consume(TOK_NEWLINE, "Expected newline after each header");
     
     // Parse body
-    int body_count = 0;
-    ASTNode** body = malloc(sizeof(ASTNode*) * 100);
-    while (current_token && current_token->type != TOK_END) {
-        if (current_token->type == TOK_NEWLINE) {
-            advance();
-            continue;
-        }
-        body[body_count++] = parse_statement();
-    }
+    int body_count;
+    ASTNode** body = parse_block(false, &body_count);
     consume(TOK_END, "Expected 'end' to close each");
     
-    ASTNode* each = malloc(sizeof(ASTNode));
-    each->type = AST_EACH;
+    ASTNode* each = new_node(AST_EACH);
     each->line = each_line;
     each->data.each.target = target;
     each->data.each.iterable = iterable;      // NULL for ranges
@@ -219,15 +304,8 @@ else if (match(KW_IF)) {
     consume(TOK_NEWLINE, "Expected newline after if condition");
     
     // Parse 'then' body (stop at 'else' or 'end')
-    int then_body_count = 0;
-    ASTNode** then_body = malloc(sizeof(ASTNode*) * 100);
-    while (current_token && current_token->type != TOK_END && current_token->type != KW_ELSE) {
-        if (current_token->type == TOK_NEWLINE) {
-            advance();
-            continue;
-        }
-        then_body[then_body_count++] = parse_statement();
-    }
+    int then_body_count;
+    ASTNode** then_body = parse_block(true, &then_body_count);
 
     // Parse optional 'else' block
     ASTNode** else_body = NULL;
@@ -237,20 +315,12 @@ else if (match(KW_IF)) {
         consume(TOK_COLON, "Expected ':' after else");
         consume(TOK_NEWLINE, "Expected newline after else");
 
-        else_body = malloc(sizeof(ASTNode*) * 100);
-        while (current_token && current_token->type != TOK_END) {
-            if (current_token->type == TOK_NEWLINE) {
-                advance();
-                continue;
-            }
-            else_body[else_body_count++] = parse_statement();
-        }
+        else_body = parse_block(false, &else_body_count);
     }
 
     consume(TOK_END, "Expected 'end' to close if");
 
-    ASTNode* if_node = malloc(sizeof(ASTNode));
-    if_node->type = AST_IF;
+    ASTNode* if_node = new_node(AST_IF);
     if_node->line = if_line;
     if_node->data.if_stmt.condition = condition;
     if_node->data.if_stmt.then_body = then_body;
@@ -263,8 +333,7 @@ else if (match(KW_IF)) {
         int give_line = current_token->line;
         advance(); // consume 'give'
         ASTNode* value = parse_expression();
-        ASTNode* ret = malloc(sizeof(ASTNode));
-        ret->type = AST_RETURN;
+        ASTNode* ret = new_node(AST_RETURN);
         ret->line = give_line;
         ret->data.expr = value;
         return ret;
@@ -272,16 +341,14 @@ else if (match(KW_IF)) {
     else if (match(KW_STOP)) {
         int stop_line = current_token->line;
         advance(); // consume 'stop'
-        ASTNode* brk = malloc(sizeof(ASTNode));
-        brk->type = AST_BREAK;
+        ASTNode* brk = new_node(AST_BREAK);
         brk->line = stop_line;
         return brk;
     }
     else if (match(KW_NEXT)) {
         int next_line = current_token->line;
         advance(); // consume 'next'
-        ASTNode* cont = malloc(sizeof(ASTNode));
-        cont->type = AST_CONTINUE;
+        ASTNode* cont = new_node(AST_CONTINUE);
         cont->line = next_line;
         return cont;
     }
@@ -289,35 +356,34 @@ else if (match(KW_IF)) {
         int print_line = current_token->line;
         advance(); // consume 'print'
         // Handle print as a function call expression
-        ASTNode** args = malloc(sizeof(ASTNode*) * 10); // Allow multiple args
-        int arg_count = 0;
+        int base = scratch_count;
 
         // In many languages, print can take a list of comma-separated expressions
         do {
-            args[arg_count++] = parse_expression();
+            scratch_push(parse_expression());
             if (match(TOK_COMMA)) {
                 advance(); // consume comma
             } else break;
         } while (true);
 
-        ASTNode* call = malloc(sizeof(ASTNode));
-        call->type = AST_CALL;
+        ASTNode* call = new_node(AST_CALL);
         call->line = current_token ? print_line : -1;
-        call->data.call.name = strdup("print"); // The name of the built-in
-        call->data.call.args = args;
-        call->data.call.arg_count = arg_count;
+        call->data.call.name = atom_intern("print"); // The name of the built-in
+        call->data.call.arg_count = scratch_count - base;
+        call->data.call.args = scratch_take(base);
+        call->data.call.builtin = -1;
+        call->data.call.function = NULL;
+        call->data.call.tail = false;
 
         // Wrap it in an expression statement
-        ASTNode* stmt = malloc(sizeof(ASTNode));
-        stmt->type = AST_EXPRSTMT;
+        ASTNode* stmt = new_node(AST_EXPRSTMT);
         stmt->line = call->line;
         stmt->data.expr = call;
         return stmt;
     } else {
         // If it's not a keyword-led statement, it must be an expression statement.
         ASTNode* expr = parse_expression();
-        ASTNode* stmt = malloc(sizeof(ASTNode));
-        stmt->type = AST_EXPRSTMT;
+        ASTNode* stmt = new_node(AST_EXPRSTMT);
         stmt->line = expr->line;
         stmt->data.expr = expr;
         return stmt;
@@ -341,11 +407,10 @@ ASTNode* parse_comparison() {
             exit(1);
         }
         ASTNode* value = parse_expression();
-        ASTNode* assign = malloc(sizeof(ASTNode));
-        assign->type = AST_ASSIGN;
+        ASTNode* assign = new_node(AST_ASSIGN);
         assign->line = expr->line;
         if (expr->type == AST_VAR) {
-            assign->data.assign.name = expr->data.var_name;
+            assign->data.assign.name = expr->data.var.name;
             assign->data.assign.index = NULL; // no index
         } else { // AST_INDEX
             assign->data.assign.name = expr->data.index.target;
@@ -359,67 +424,73 @@ ASTNode* parse_comparison() {
         if (match(TOK_EQ)) {
             advance();
             ASTNode* right = parse_term();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("==");
+            binop->data.binop.op = BINOP_EQ;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_NEQ)) {
             advance();
             ASTNode* right = parse_term();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("!=");
+            binop->data.binop.op = BINOP_NEQ;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_LT)) {
             advance();
             ASTNode* right = parse_term();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("<");
+            binop->data.binop.op = BINOP_LT;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_LE)) {
             advance();
             ASTNode* right = parse_term();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("<=");
+            binop->data.binop.op = BINOP_LE;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_GT)) {
             advance();
             ASTNode* right = parse_term();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup(">");
+            binop->data.binop.op = BINOP_GT;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_GE)) {
             advance();
             ASTNode* right = parse_term();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup(">=");
+            binop->data.binop.op = BINOP_GE;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else {
@@ -437,23 +508,25 @@ ASTNode* parse_term() {
         if (match(TOK_PLUS)) {
             advance();
             ASTNode* right = parse_factor();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("+");
+            binop->data.binop.op = BINOP_ADD;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_MINUS)) {
             advance();
             ASTNode* right = parse_factor();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("-");
+            binop->data.binop.op = BINOP_SUB;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else {
@@ -471,23 +544,25 @@ ASTNode* parse_factor() {
         if (match(TOK_TIMES)) {
             advance();
             ASTNode* right = parse_unary();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("*");
+            binop->data.binop.op = BINOP_MUL;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else if (match(TOK_DIVIDE)) {
             advance();
             ASTNode* right = parse_unary();
-            ASTNode* binop = malloc(sizeof(ASTNode));
-            binop->type = AST_BINOP;
+            ASTNode* binop = new_node(AST_BINOP);
             binop->line = current_token->line;
             binop->data.binop.left = expr;
-            binop->data.binop.op = strdup("/");
+            binop->data.binop.op = BINOP_DIV;
             binop->data.binop.right = right;
+            binop->data.binop.quick = QUICK_NONE;
+            binop->data.binop.site = NULL;
             expr = binop;
         }
         else {
@@ -502,10 +577,9 @@ ASTNode* parse_unary() {
     if (match(TOK_MINUS)) {
         advance();
         ASTNode* operand = parse_unary();
-        ASTNode* unary = malloc(sizeof(ASTNode));
-        unary->type = AST_UNARYOP;
+        ASTNode* unary = new_node(AST_UNARYOP);
         unary->line = current_token->line;
-        unary->data.unaryop.op = strdup("-");
+        unary->data.unaryop.op = UNOP_NEGATE;
         unary->data.unaryop.operand = operand;
         return unary;
     }
@@ -515,51 +589,46 @@ ASTNode* parse_unary() {
 
 ASTNode* parse_primary() {
     if (match(TOK_NUMBER)) {
-        char* value = strdup(current_token->value);
+        double value = token_number(current_token);
         int line = current_token->line;
         advance();
-        ASTNode* num = malloc(sizeof(ASTNode));
-        num->type = AST_NUMBER;
+        ASTNode* num = new_node(AST_NUMBER);
         num->line = line;
-        num->data.number = atof(value);
-        free(value);
+        num->data.number = value;
         return num;
     }
     else if (match(TOK_STRING)) {
-        char* value = strdup(current_token->value);
+        char* value = arena_alloc(&ast_arena, current_token->length + 1);
+        token_string(current_token, value);
         int line = current_token->line;
         advance();
-        ASTNode* str = malloc(sizeof(ASTNode));
-        str->type = AST_STRING;
+        ASTNode* str = new_node(AST_STRING);
         str->line = line;
         str->data.string = value;
         return str;
     }
     else if (match(KW_TRUE)) {
         advance();
-        ASTNode* bool_node = malloc(sizeof(ASTNode));
-        bool_node->type = AST_BOOLEAN;
+        ASTNode* bool_node = new_node(AST_BOOLEAN);
         bool_node->line = current_token->line;
         bool_node->data.boolean = true;
         return bool_node;
     }
     else if (match(KW_FALSE)) {
         advance();
-        ASTNode* bool_node = malloc(sizeof(ASTNode));
-        bool_node->type = AST_BOOLEAN;
+        ASTNode* bool_node = new_node(AST_BOOLEAN);
         bool_node->line = current_token->line;
         bool_node->data.boolean = false;
         return bool_node;
     }
     else if (match(KW_NULL)) {
         advance();
-        ASTNode* null_node = malloc(sizeof(ASTNode));
-        null_node->type = AST_NULL;
+        ASTNode* null_node = new_node(AST_NULL);
         null_node->line = current_token->line;
         return null_node;
     }
     else if (match(TOK_ID)) {
-        char* id_name = strdup(current_token->value);
+        Atom id_name = token_atom();
         int line = current_token->line;
         advance();
 
@@ -569,8 +638,7 @@ ASTNode* parse_primary() {
             ASTNode* index_expr = parse_expression();
             consume(TOK_RBRACKET, "Expected ']'");
 
-            ASTNode* index_node = malloc(sizeof(ASTNode));
-            index_node->type = AST_INDEX;
+            ASTNode* index_node = new_node(AST_INDEX);
             index_node->line = line;
             index_node->data.index.target = id_name;      // variable name
             index_node->data.index.index = index_expr;    // index expression
@@ -580,50 +648,75 @@ ASTNode* parse_primary() {
         // Check if it's a function call
         if (match(TOK_LPAREN)) {
             advance(); // consume '('
-            ASTNode** args = malloc(sizeof(ASTNode*) * 10);
-            int arg_count = 0;
+            int base = scratch_count;
             if (!match(TOK_RPAREN)) {
                 do {
-                    args[arg_count++] = parse_expression();
+                    scratch_push(parse_expression());
                 } while (match(TOK_COMMA) && (advance(), true));
             }
             consume(TOK_RPAREN, "Expected ')'");
 
-            ASTNode* call = malloc(sizeof(ASTNode));
-            call->type = AST_CALL;
+            ASTNode* call = new_node(AST_CALL);
             call->line = line;
             call->data.call.name = id_name;
-            call->data.call.args = args;
-            call->data.call.arg_count = arg_count;
+            call->data.call.arg_count = scratch_count - base;
+            call->data.call.args = scratch_take(base);
+            call->data.call.builtin = -1;
+            call->data.call.function = NULL;
+            call->data.call.tail = false;
             return call;
         }
 
         // Otherwise, it's a variable
-        ASTNode* var = malloc(sizeof(ASTNode));
-        var->type = AST_VAR;
+        ASTNode* var = new_node(AST_VAR);
         var->line = line;
-        var->data.var_name = id_name;
+        var->data.var.name = id_name;
         return var;
     }
     else if (match(TOK_LBRACKET)) {
         advance();
-        ASTNode** items = malloc(sizeof(ASTNode*) * 10);
-        int count = 0;
+        int base = scratch_count;
         
         if (!match(TOK_RBRACKET)) {
             do {
-                items[count++] = parse_expression();
+                scratch_push(parse_expression());
             } while (match(TOK_COMMA) && (advance(), true));
-            consume(TOK_RBRACKET, "Expected ']'");
         }
+        consume(TOK_RBRACKET, "Expected ']'");
         
-        ASTNode* list = malloc(sizeof(ASTNode));
-        list->type = AST_LIST;
+        ASTNode* list = new_node(AST_LIST);
         list->line = current_token->line;
-        list->data.list.items = items;
-        list->data.list.count = count;
+        list->data.list.count = scratch_count - base;
+        list->data.list.items = scratch_take(base);
         return list;
     }
+    else if (match(TOK_LBRACE)) {
+        advance();
+        // Keys and values are pushed in pairs
+        int base = scratch_count;
+
+        if (!match(TOK_RBRACE)) {
+            do {
+                scratch_push(parse_expression());
+                consume(TOK_COLON, "Expected ':' after dictionary key");
+                scratch_push(parse_expression());
+            } while (match(TOK_COMMA) && (advance(), true));
+        }
+        consume(TOK_RBRACE, "Expected '}'");
+
+        ASTNode* dict = new_node(AST_DICT);
+        dict->line = current_token->line;
+        int count = (scratch_count - base) / 2;
+        dict->data.dict.keys = arena_alloc(&ast_arena, sizeof(ASTNode*) * count);
+        dict->data.dict.values = arena_alloc(&ast_arena, sizeof(ASTNode*) * count);
+        for (int i = 0; i < count; i++) {
+            dict->data.dict.keys[i] = scratch[base + 2 * i];
+            dict->data.dict.values[i] = scratch[base + 2 * i + 1];
+        }
+        dict->data.dict.count = count;
+        scratch_count = base;
+        return dict;
+    }
     else if (match(TOK_LPAREN)) {
         advance();
         ASTNode* expr = parse_expression();
@@ -636,6 +729,12 @@ ASTNode* parse_primary() {
     exit(1);
 }
 
+const char* const binop_names[] = {
+    [BINOP_ADD] = "+", [BINOP_SUB] = "-", [BINOP_MUL] = "*", [BINOP_DIV] = "/",
+    [BINOP_EQ] = "==", [BINOP_NEQ] = "!=", [BINOP_LT] = "<", [BINOP_LE] = "<=",
+    [BINOP_GT] = ">", [BINOP_GE] = ">="
+};
+
 // Function to print the AST (for debugging)
 void print_ast(ASTNode* node, int indent) {
     if (!node) return;
@@ -650,16 +749,17 @@ void print_ast(ASTNode* node, int indent) {
             }
             break;
         case AST_ASSIGN:
-            printf("ASSIGN: %s\n", node->data.assign.name);
+            printf("ASSIGN: %s%s\n", node->data.assign.name, node->data.assign.index ? "[...]" : "");
+            print_ast(node->data.assign.index, indent + 1);
             print_ast(node->data.assign.value, indent + 1);
             break;
         case AST_BINOP:
-            printf("BINOP: %s\n", node->data.binop.op);
+            printf("BINOP: %s\n", binop_names[node->data.binop.op]);
             print_ast(node->data.binop.left, indent + 1);
             print_ast(node->data.binop.right, indent + 1);
             break;
         case AST_UNARYOP:
-            printf("UNARYOP: %s\n", node->data.unaryop.op);
+            printf("UNARYOP: -\n");
             print_ast(node->data.unaryop.operand, indent + 1);
             break;
         case AST_NUMBER:
@@ -675,7 +775,7 @@ void print_ast(ASTNode* node, int indent) {
             printf("NULL\n");
             break;
         case AST_VAR:
-            printf("VAR: %s\n", node->data.var_name);
+            printf("VAR: %s\n", node->data.var.name);
             break;
         case AST_LIST:
             printf("LIST (items: %d)\n", node->data.list.count);
@@ -683,6 +783,13 @@ void print_ast(ASTNode* node, int indent) {
                 print_ast(node->data.list.items[i], indent + 1);
             }
             break;
+        case AST_DICT:
+            printf("DICT (entries: %d)\n", node->data.dict.count);
+            for (int i = 0; i < node->data.dict.count; i++) {
+                print_ast(node->data.dict.keys[i], indent + 1);
+                print_ast(node->data.dict.values[i], indent + 2);
+            }
+            break;
         case AST_CALL:
             printf("CALL: %s (args: %d)\n", node->data.call.name, node->data.call.arg_count);
             for (int i = 0; i < node->data.call.arg_count; i++) {
@@ -713,6 +820,8 @@ void print_ast(ASTNode* node, int indent) {
         case AST_EACH:
             printf("EACH: %s\n", node->data.each.target);
             print_ast(node->data.each.iterable, indent + 1);
+            print_ast(node->data.each.range_start, indent + 1);
+            print_ast(node->data.each.range_end, indent + 1);
             for (int i = 0; i < node->data.each.body_count; i++) {
                 print_ast(node->data.each.body[i], indent + 1);
             }
@@ -721,10 +830,29 @@ void print_ast(ASTNode* node, int indent) {
             printf("EXPRSTMT\n");
             print_ast(node->data.expr, indent + 1);
             break;
+        case AST_RETURN:
+            printf("GIVE\n");
+            print_ast(node->data.expr, indent + 1);
+            break;
+        case AST_BREAK:
+            printf("STOP\n");
+            break;
+        case AST_CONTINUE:
+            printf("NEXT\n");
+            break;
+        case AST_FUNCDEF:
+            printf("FUNCDEF: %s (", node->data.funcdef.name);
+            for (int i = 0; i < node->data.funcdef.param_count; i++) {
+                printf(i > 0 ? ", %s" : "%s", node->data.funcdef.params[i]);
+            }
+            printf(")\n");
+            for (int i = 0; i < node->data.funcdef.body_count; i++) {
+                print_ast(node->data.funcdef.body[i], indent + 1);
+            }
+            break;
         case AST_INDEX:
-            printf("INDEX: %s[", node->data.index.target);
-            print_ast(node->data.index.index, 0); // print index expr inline
-            printf("]\n");
+            printf("INDEX: %s\n", node->data.index.target);
+            print_ast(node->data.index.index, indent + 1);
             break;
         default:
             printf("UNKNOWN AST NODE TYPE: %d\n", node->type);
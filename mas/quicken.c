@@ -0,0 +1,39 @@
+// quicken.c
+#include "mas.h"
+
+// Binary operations rewrite themselves into a specialized form the first
+// time they run with number operands: the tree walker then reads variable
+// and literal operands straight from their slots, and the VM fuses a
+// comparison with the branch that consumes it. Each specialized site counts
+// how often the fast form ran (hits) and how often an operand that was not a
+// number sent it back to the generic form (misses); --quicken-stats prints
+// them at exit. Without it no sites are allocated: the tree walker needs
+// none, and a VM comparison keeps its one bit of history in its operand.
+
+QuickSite** quick_sites = NULL;
+int quick_site_count = 0;
+static int quick_site_capacity = 0;
+
+// Sites are allocated one by one, so pointers to them stay valid while
+// the table grows
+QuickSite* quick_site_new(int line, BinaryOp op) {
+    if (quick_site_count >= quick_site_capacity) {
+        quick_site_capacity = quick_site_capacity ? quick_site_capacity * 2 : 64;
+        quick_sites = realloc(quick_sites, sizeof(QuickSite*) * quick_site_capacity);
+    }
+    QuickSite* site = calloc(1, sizeof(QuickSite));
+    site->index = quick_site_count;
+    site->line = line;
+    site->op = op;
+    quick_sites[quick_site_count++] = site;
+    return site;
+}
+
+void quick_print_stats(void) {
+    for (int i = 0; i < quick_site_count; i++) {
+        QuickSite* site = quick_sites[i];
+        if (!site->form) continue;
+        fprintf(stderr, "[quicken] line %d '%s' (%s): %lu hits, %lu misses\n",
+                site->line, binop_names[site->op], site->form, site->hits, site->misses);
+    }
+}
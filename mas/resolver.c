@@ -0,0 +1,217 @@
+// resolver.c
+#include "mas.h"
+
+// Binds every variable reference to a fixed slot before the program runs.
+// Names assigned inside a function (parameters, plain assignments and
+// 'each' targets) are locals of that function; every other name, and every
+// name at the top level, is a global. Names are atoms, compared by pointer.
+
+// A scope maps each of its names to a slot; slots are handed out in order,
+// so the next one is the number of names so far
+typedef AtomMap NameList;
+
+static NameList globals;
+static NameList* locals = NULL;   // scope of the function being resolved
+
+static void resolve_node(ASTNode* node);
+
+static int find_name(NameList* list, Atom name) {
+    return atom_map_get(list, name);
+}
+
+static int add_name(NameList* list, Atom name) {
+    int slot = find_name(list, name);
+    if (slot >= 0) return slot;
+
+    slot = list->count;
+    atom_map_set(list, name, slot);
+    return slot;
+}
+
+// Look up a name in the current scope, falling back to (and creating) a global
+static void bind(Atom name, int* slot, bool* global) {
+    if (locals) {
+        int local = find_name(locals, name);
+        if (local >= 0) {
+            *slot = local;
+            *global = false;
+            return;
+        }
+    }
+    *slot = add_name(&globals, name);
+    *global = true;
+}
+
+// Collect the names a function body assigns to, without entering nested defs
+static void declare_locals(ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+    case AST_ASSIGN:
+        if (node->data.assign.index == NULL) {
+            add_name(locals, node->data.assign.name);
+        }
+        declare_locals(node->data.assign.value);
+        declare_locals(node->data.assign.index);
+        break;
+    case AST_INDEX:
+        declare_locals(node->data.index.index);
+        break;
+    case AST_BINOP:
+        declare_locals(node->data.binop.left);
+        declare_locals(node->data.binop.right);
+        break;
+    case AST_UNARYOP:
+        declare_locals(node->data.unaryop.operand);
+        break;
+    case AST_LIST:
+        for (int i = 0; i < node->data.list.count; i++) {
+            declare_locals(node->data.list.items[i]);
+        }
+        break;
+    case AST_DICT:
+        for (int i = 0; i < node->data.dict.count; i++) {
+            declare_locals(node->data.dict.keys[i]);
+            declare_locals(node->data.dict.values[i]);
+        }
+        break;
+    case AST_CALL:
+        for (int i = 0; i < node->data.call.arg_count; i++) {
+            declare_locals(node->data.call.args[i]);
+        }
+        break;
+    case AST_IF:
+        declare_locals(node->data.if_stmt.condition);
+        for (int i = 0; i < node->data.if_stmt.then_body_count; i++) {
+            declare_locals(node->data.if_stmt.then_body[i]);
+        }
+        for (int i = 0; i < node->data.if_stmt.else_body_count; i++) {
+            declare_locals(node->data.if_stmt.else_body[i]);
+        }
+        break;
+    case AST_LOOP:
+        declare_locals(node->data.loop.condition);
+        for (int i = 0; i < node->data.loop.body_count; i++) {
+            declare_locals(node->data.loop.body[i]);
+        }
+        break;
+    case AST_EACH:
+        add_name(locals, node->data.each.target);
+        declare_locals(node->data.each.iterable);
+        declare_locals(node->data.each.range_start);
+        declare_locals(node->data.each.range_end);
+        for (int i = 0; i < node->data.each.body_count; i++) {
+            declare_locals(node->data.each.body[i]);
+        }
+        break;
+    case AST_EXPRSTMT:
+    case AST_RETURN:
+        declare_locals(node->data.expr);
+        break;
+    default:
+        break;
+    }
+}
+
+static void resolve_block(ASTNode** body, int count) {
+    for (int i = 0; i < count; i++) {
+        resolve_node(body[i]);
+    }
+}
+
+static void resolve_function(ASTNode* node) {
+    NameList scope = {0};
+    NameList* enclosing = locals;
+    locals = &scope;
+
+    for (int i = 0; i < node->data.funcdef.param_count; i++) {
+        add_name(locals, node->data.funcdef.params[i]);
+    }
+    for (int i = 0; i < node->data.funcdef.body_count; i++) {
+        declare_locals(node->data.funcdef.body[i]);
+    }
+    resolve_block(node->data.funcdef.body, node->data.funcdef.body_count);
+    node->data.funcdef.local_count = scope.count;
+
+    atom_map_free(&scope);
+    locals = enclosing;
+}
+
+static void resolve_node(ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+    case AST_PROGRAM:
+        resolve_block(node->data.list.items, node->data.list.count);
+        break;
+    case AST_VAR:
+        bind(node->data.var.name, &node->data.var.slot, &node->data.var.global);
+        break;
+    case AST_ASSIGN:
+        resolve_node(node->data.assign.value);
+        resolve_node(node->data.assign.index);
+        bind(node->data.assign.name, &node->data.assign.slot, &node->data.assign.global);
+        break;
+    case AST_INDEX:
+        resolve_node(node->data.index.index);
+        bind(node->data.index.target, &node->data.index.slot, &node->data.index.global);
+        break;
+    case AST_BINOP:
+        resolve_node(node->data.binop.left);
+        resolve_node(node->data.binop.right);
+        break;
+    case AST_UNARYOP:
+        resolve_node(node->data.unaryop.operand);
+        break;
+    case AST_LIST:
+        resolve_block(node->data.list.items, node->data.list.count);
+        break;
+    case AST_DICT:
+        resolve_block(node->data.dict.keys, node->data.dict.count);
+        resolve_block(node->data.dict.values, node->data.dict.count);
+        break;
+    case AST_CALL:
+        resolve_block(node->data.call.args, node->data.call.arg_count);
+        node->data.call.builtin = find_builtin(node->data.call.name);
+        break;
+    case AST_IF:
+        resolve_node(node->data.if_stmt.condition);
+        resolve_block(node->data.if_stmt.then_body, node->data.if_stmt.then_body_count);
+        resolve_block(node->data.if_stmt.else_body, node->data.if_stmt.else_body_count);
+        break;
+    case AST_LOOP:
+        resolve_node(node->data.loop.condition);
+        resolve_block(node->data.loop.body, node->data.loop.body_count);
+        break;
+    case AST_EACH:
+        resolve_node(node->data.each.iterable);
+        resolve_node(node->data.each.range_start);
+        resolve_node(node->data.each.range_end);
+        bind(node->data.each.target, &node->data.each.slot, &node->data.each.global);
+        resolve_block(node->data.each.body, node->data.each.body_count);
+        break;
+    case AST_FUNCDEF:
+        resolve_function(node);
+        break;
+    case AST_EXPRSTMT:
+        resolve_node(node->data.expr);
+        break;
+    case AST_RETURN:
+        resolve_node(node->data.expr);
+        // 'give f(...)' in a function can reuse the caller's frame
+        if (locals && node->data.expr->type == AST_CALL && node->data.expr->data.call.builtin < 0) {
+            node->data.expr->data.call.tail = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void resolve_program(ASTNode* program) {
+    resolve_node(program);
+}
+
+int resolver_global_count() {
+    return globals.count;
+}
@@ -0,0 +1,199 @@
+// slab.c
+#include "mas.h"
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Size-class slab allocator for old-space objects and their payloads.
+// Memory is carved out of 64 KB pages, each dedicated to one cell size and
+// aligned to its own size so a cell finds its page by masking its address.
+// Each page keeps its own free list; a page whose cells are all free is
+// handed back to the system, so sweeping returns memory a page at a time.
+// Requests larger than the biggest class go straight to malloc.
+
+#define SLAB_PAGE_SIZE (64 * 1024)
+
+typedef struct SlabClass SlabClass;
+
+typedef struct SlabPage {
+    struct SlabPage* next;        // pages of the class that have free cells
+    struct SlabPage* prev;
+    void* free_list;              // cells released by slab_free
+    char* bump;                   // cells never handed out start here
+    int used;
+    int capacity;
+    bool available;               // linked into owner->pages
+} SlabPage;
+
+struct SlabClass {
+    size_t cell_size;
+    SlabPage* pages;              // pages with at least one free cell
+    int page_count;
+    size_t cells_used;
+    size_t cells_total;
+};
+
+// Class 0 holds MASObject headers; the rest hold string bytes and list items
+#define CLASS(size) {.cell_size = (size)}
+static SlabClass classes[] = {
+    CLASS(sizeof(MASObject)), CLASS(16), CLASS(32), CLASS(48), CLASS(64),
+    CLASS(96), CLASS(128), CLASS(192), CLASS(256), CLASS(384), CLASS(512),
+    CLASS(768), CLASS(1024), CLASS(1536), CLASS(2048), CLASS(3072), CLASS(4096),
+};
+#define CLASS_COUNT ((int)(sizeof(classes) / sizeof(classes[0])))
+#define MAX_CELL 4096
+
+// Payload size (in 16-byte steps) -> index into classes, filled on first use
+static unsigned char class_index[MAX_CELL / 16 + 1];
+
+static size_t large_count = 0;
+static size_t large_bytes = 0;
+
+#define PAGE_HEADER_SIZE ((sizeof(SlabPage) + 15) & ~(size_t)15)
+#define PAGE_OF(ptr) ((SlabPage*)((uintptr_t)(ptr) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1)))
+
+static SlabClass* class_for(size_t size) {
+    if (size > MAX_CELL) return NULL;
+    if (class_index[0] == 0) {
+        int c = 1;
+        for (int i = 0; i <= MAX_CELL / 16; i++) {
+            while (classes[c].cell_size < (size_t)i * 16) c++;
+            class_index[i] = (unsigned char)c;
+        }
+    }
+    return &classes[class_index[(size + 15) / 16]];
+}
+
+static void link_page(SlabClass* cls, SlabPage* page) {
+    page->prev = NULL;
+    page->next = cls->pages;
+    if (cls->pages) cls->pages->prev = page;
+    cls->pages = page;
+    page->available = true;
+}
+
+static void unlink_page(SlabClass* cls, SlabPage* page) {
+    if (page->prev) page->prev->next = page->next;
+    else cls->pages = page->next;
+    if (page->next) page->next->prev = page->prev;
+    page->available = false;
+}
+
+// Pages are aligned to their size so PAGE_OF works
+static void* page_alloc() {
+#ifdef _WIN32
+    return _aligned_malloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+#else
+    void* memory;
+    return posix_memalign(&memory, SLAB_PAGE_SIZE, SLAB_PAGE_SIZE) == 0 ? memory : NULL;
+#endif
+}
+
+static void page_free(SlabPage* page) {
+#ifdef _WIN32
+    _aligned_free(page);
+#else
+    free(page);
+#endif
+}
+
+static SlabPage* new_page(SlabClass* cls) {
+    SlabPage* page = page_alloc();
+    if (!page) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    page->free_list = NULL;
+    page->bump = (char*)page + PAGE_HEADER_SIZE;
+    page->used = 0;
+    page->capacity = (int)((SLAB_PAGE_SIZE - PAGE_HEADER_SIZE) / cls->cell_size);
+    link_page(cls, page);
+
+    cls->page_count++;
+    cls->cells_total += page->capacity;
+    return page;
+}
+
+static void* class_alloc(SlabClass* cls) {
+    SlabPage* page = cls->pages ? cls->pages : new_page(cls);
+
+    void* cell;
+    if (page->free_list) {
+        cell = page->free_list;
+        page->free_list = *(void**)cell;
+    } else {
+        cell = page->bump;
+        page->bump += cls->cell_size;
+    }
+    page->used++;
+    cls->cells_used++;
+
+    if (page->used == page->capacity) {
+        unlink_page(cls, page);
+    }
+    return cell;
+}
+
+static void class_free(SlabClass* cls, void* cell) {
+    SlabPage* page = PAGE_OF(cell);
+    *(void**)cell = page->free_list;
+    page->free_list = cell;
+    page->used--;
+    cls->cells_used--;
+
+    if (page->used == 0 && cls->page_count > 1) {
+        // Return the whole page, keeping one per class to avoid thrashing
+        if (page->available) unlink_page(cls, page);
+        cls->page_count--;
+        cls->cells_total -= page->capacity;
+        page_free(page);
+    } else if (!page->available) {
+        link_page(cls, page);
+    }
+}
+
+MASObject* slab_alloc_object() {
+    MASObject* obj = class_alloc(&classes[0]);
+    memset(obj, 0, sizeof(MASObject));
+    return obj;
+}
+
+void slab_free_object(MASObject* obj) {
+    class_free(&classes[0], obj);
+}
+
+// Payloads are freed with the size they were allocated with
+void* slab_alloc(size_t size) {
+    if (size == 0) return NULL;
+    SlabClass* cls = class_for(size);
+    if (cls) return class_alloc(cls);
+
+    large_count++;
+    large_bytes += size;
+    return malloc(size);
+}
+
+void slab_free(void* ptr, size_t size) {
+    if (!ptr) return;
+    SlabClass* cls = class_for(size);
+    if (cls) {
+        class_free(cls, ptr);
+        return;
+    }
+
+    large_count--;
+    large_bytes -= size;
+    free(ptr);
+}
+
+void slab_print_stats() {
+    for (int i = 0; i < CLASS_COUNT; i++) {
+        SlabClass* cls = &classes[i];
+        if (cls->page_count == 0) continue;
+        fprintf(stderr, "[GC] slab %4zu B%s: %d pages, %zu of %zu cells in use (%.0f%%)\n",
+                cls->cell_size, i == 0 ? " (objects)" : "", cls->page_count,
+                cls->cells_used, cls->cells_total,
+                cls->cells_total ? 100.0 * cls->cells_used / cls->cells_total : 0.0);
+    }
+    fprintf(stderr, "[GC] large payloads: %zu (%zu bytes)\n", large_count, large_bytes);
+}
@@ -0,0 +1,567 @@
+// vm.c
+#include "mas.h"
+
+typedef struct {
+    FunctionProto* proto;     // NULL for the top-level program
+    Chunk* chunk;
+    int* ip;
+    int base;                 // stack index of local slot 0; operands follow the locals
+} CallFrame;
+
+struct VM {
+    Interpreter interp;       // globals and built-in context
+    Value* stack;
+    int stack_capacity;
+    int stack_top;            // synced from the run loop before anything can collect
+    CallFrame* frames;
+    int frame_count;
+    int frame_capacity;
+    struct {
+        AtomMap names;            // name -> index into protos
+        FunctionProto** protos;
+        int count;
+        int capacity;
+    } functions;
+};
+
+// Locals live on the stack, so this covers every frame
+void vm_mark_roots(VM* vm) {
+    gc_visit_roots(vm->stack, vm->stack_top);
+}
+
+// The first definition of a name is the one calls find. Functions keep
+// their index for the life of the VM, so call sites can be bound to it.
+static void vm_define_function(VM* vm, FunctionProto* proto) {
+    if (atom_map_get(&vm->functions.names, proto->name) >= 0) return;
+    if (vm->functions.count >= vm->functions.capacity) {
+        vm->functions.capacity = vm->functions.capacity ? vm->functions.capacity * 2 : 16;
+        vm->functions.protos = realloc(vm->functions.protos, sizeof(FunctionProto*) * vm->functions.capacity);
+    }
+    atom_map_set(&vm->functions.names, proto->name, vm->functions.count);
+    vm->functions.protos[vm->functions.count] = proto;
+    vm->functions.count++;
+}
+
+// Make sure 'needed' more slots fit above stack_top
+static void vm_reserve_stack(VM* vm, int needed) {
+    if (vm->stack_top + needed <= vm->stack_capacity) return;
+    while (vm->stack_top + needed > vm->stack_capacity) {
+        vm->stack_capacity = vm->stack_capacity ? vm->stack_capacity * 2 : 256;
+    }
+    vm->stack = realloc(vm->stack, sizeof(Value) * vm->stack_capacity);
+}
+
+// Start 'frame' on a chunk whose first 'argc' locals are already on top of
+// the stack
+static void vm_enter_frame(VM* vm, CallFrame* frame, FunctionProto* proto, Chunk* chunk, int argc) {
+    int local_count = proto ? proto->local_count : 0;
+    vm_reserve_stack(vm, local_count - argc + chunk->max_stack);
+
+    frame->proto = proto;
+    frame->chunk = chunk;
+    frame->ip = chunk->code;
+    frame->base = vm->stack_top - argc;
+    for (int i = argc; i < local_count; i++) {
+        vm->stack[vm->stack_top++] = NUMBER_VAL(0);
+    }
+}
+
+static void vm_push_frame(VM* vm, FunctionProto* proto, Chunk* chunk, int argc) {
+    if (vm->frame_count >= vm->frame_capacity) {
+        vm->frame_capacity = vm->frame_capacity ? vm->frame_capacity * 2 : 64;
+        vm->frames = realloc(vm->frames, sizeof(CallFrame) * vm->frame_capacity);
+    }
+    vm_enter_frame(vm, &vm->frames[vm->frame_count++], proto, chunk, argc);
+}
+
+// A comparison's operand is its QuickSite index with --quicken-stats, or
+// QUICK_NO_SITE / QUICK_MISSED
+static bool site_missed(int site) {
+    return site >= 0 ? quick_sites[site]->misses > 0 : site == QUICK_MISSED;
+}
+
+static Value vm_run(VM* vm) {
+    CallFrame* frame = &vm->frames[vm->frame_count - 1];
+    int* ip = frame->ip;
+    Value* sp = vm->stack + vm->stack_top;
+    Value* slots = vm->stack + frame->base;
+    Value* globals = vm->interp.globals;
+    Value* constants = frame->chunk->constants;
+
+#define READ() (*ip++)
+#define PUSH(v) (*sp++ = (v))
+#define POP() (*--sp)
+#define PEEK(n) (sp[-1 - (n)])
+#define LINE() (frame->chunk->lines[ip - 1 - frame->chunk->code])
+// Publish the stack pointer so the GC sees every live temporary
+#define SYNC() (vm->stack_top = (int)(sp - vm->stack))
+// Reload the cached registers after the frame stack changed
+#define LOAD_FRAME() do { \
+        frame = &vm->frames[vm->frame_count - 1]; \
+        ip = frame->ip; \
+        slots = vm->stack + frame->base; \
+        constants = frame->chunk->constants; \
+    } while (0)
+
+// Run the frame's native code from ip until it reaches an instruction it
+// leaves to the interpreter (see jit.c). ENTER_JIT is used where a chunk
+// gets hot (calls and loop back edges) and compiles it at the threshold;
+// RESUME_JIT picks compiled code back up after a call returns.
+#define RUN_JIT() (ip = jit_run(frame->chunk, ip, &sp, slots, globals))
+#define ENTER_JIT() do { \
+        if (options.jit && (frame->chunk->jit || jit_hot(frame->chunk))) RUN_JIT(); \
+    } while (0)
+#define RESUME_JIT() do { \
+        if (frame->chunk->jit) RUN_JIT(); \
+    } while (0)
+
+#if defined(__GNUC__)
+    // Direct threading through a table of label addresses
+    static void* dispatch_table[] = {
+#define X(name) &&op_##name,
+        OPCODE_LIST(X)
+#undef X
+    };
+#define DISPATCH() goto *dispatch_table[READ()]
+#define CASE(name) op_##name:
+    DISPATCH();
+#else
+#define DISPATCH() continue
+#define CASE(name) case OP_##name:
+    for (;;) {
+        switch (READ()) {
+#endif
+
+    CASE(CONSTANT) {
+        PUSH(constants[READ()]);
+        DISPATCH();
+    }
+    CASE(STRING) {
+        MASObject* literal = AS_OBJ(constants[READ()]);
+        SYNC();
+        PUSH(create_string(literal->data.string));
+        DISPATCH();
+    }
+    CASE(NULL) {
+        PUSH(NULL_VAL);
+        DISPATCH();
+    }
+    CASE(TRUE) {
+        PUSH(TRUE_VAL);
+        DISPATCH();
+    }
+    CASE(FALSE) {
+        PUSH(FALSE_VAL);
+        DISPATCH();
+    }
+    CASE(POP) {
+        sp--;
+        DISPATCH();
+    }
+    CASE(GET_LOCAL) {
+        // Unassigned slots hold 0 (all bits clear), which reads as the number 0
+        PUSH(slots[READ()]);
+        DISPATCH();
+    }
+    CASE(SET_LOCAL) {
+        slots[READ()] = PEEK(0);
+        DISPATCH();
+    }
+    CASE(GET_GLOBAL) {
+        PUSH(globals[READ()]);
+        DISPATCH();
+    }
+    CASE(SET_GLOBAL) {
+        globals[READ()] = PEEK(0);
+        DISPATCH();
+    }
+    CASE(GET_INDEX) {
+        const char* name = AS_STRING(constants[READ()]);
+        Value index_val = POP();
+        Value list_val = PEEK(0);
+        if (IS_DICT(list_val)) {
+            // Missing keys read as null
+            Value value = NULL_VAL;
+            dict_check_key(index_val);
+            dict_get(AS_OBJ(list_val), index_val, &value);
+            PEEK(0) = value;
+            DISPATCH();
+        }
+        if (!IS_LIST(list_val)) {
+            fprintf(stderr, "Error: '%s' is not a list or dictionary (line %d)\n", name, LINE());
+            exit(1);
+        }
+        if (!IS_NUMBER(index_val)) {
+            fprintf(stderr, "List index must be a number (line %d)\n", LINE());
+            exit(1);
+        }
+        MASObject* list_obj = AS_OBJ(list_val);
+        int idx = (int)AS_NUMBER(index_val);
+        if (idx < 0 || idx >= list_obj->data.list.count) {
+            fprintf(stderr, "Index %d out of bounds (line %d)\n", idx, LINE());
+            exit(1);
+        }
+        PEEK(0) = list_obj->data.list.items[idx];
+        DISPATCH();
+    }
+    CASE(SET_INDEX) {
+        const char* name = AS_STRING(constants[READ()]);
+        Value index_val = POP();
+        Value list_val = POP();
+        if (IS_DICT(list_val)) {
+            dict_check_key(index_val);
+            dict_set(AS_OBJ(list_val), index_val, PEEK(0));
+            DISPATCH();
+        }
+        if (!IS_LIST(list_val)) {
+            fprintf(stderr, "Error: '%s' is not a list or dictionary\n", name);
+            exit(1);
+        }
+        if (!IS_NUMBER(index_val)) {
+            fprintf(stderr, "List index must be a number\n");
+            exit(1);
+        }
+        MASObject* list_obj = AS_OBJ(list_val);
+        int idx = (int)AS_NUMBER(index_val);
+        if (idx < 0 || idx >= list_obj->data.list.count) {
+            fprintf(stderr, "Index %d out of bounds\n", idx);
+            exit(1);
+        }
+        list_obj->data.list.items[idx] = PEEK(0);
+        gc_write_barrier(list_obj, PEEK(0));
+        DISPATCH();
+    }
+
+#define NUMBER_OPERANDS() \
+        Value right = PEEK(0); \
+        Value left = PEEK(1); \
+        if (!IS_NUMBER(left) || !IS_NUMBER(right)) { \
+            fprintf(stderr, "Type error: binary operation requires numbers\n"); \
+            exit(1); \
+        } \
+        double lval = AS_NUMBER(left); \
+        double rval = AS_NUMBER(right)
+#define ARITH(name, expr) CASE(name) { \
+        NUMBER_OPERANDS(); \
+        sp--; \
+        PEEK(0) = NUMBER_VAL(expr); \
+        DISPATCH(); \
+    }
+// A comparison whose result goes straight to a branch quickens into the
+// fused form the first time it sees two numbers. The fused form falls back
+// to the generic one when an operand is not a number, for good.
+#define COMPARE(name, expr) CASE(name) { \
+        int site = READ(); \
+        NUMBER_OPERANDS(); \
+        sp--; \
+        PEEK(0) = BOOL_VAL(expr); \
+        if (ip[0] == OP_JUMP_IF_FALSE && !site_missed(site)) { \
+            if (site >= 0) quick_sites[site]->form = "branch"; \
+            ip[-2] = OP_##name##_JUMP; \
+        } \
+        DISPATCH(); \
+    } \
+    CASE(name##_JUMP) { \
+        int site = READ(); \
+        Value right = PEEK(0); \
+        Value left = PEEK(1); \
+        if (!IS_NUMBER(left) || !IS_NUMBER(right)) { \
+            if (site >= 0) quick_sites[site]->misses++; \
+            else ip[-1] = QUICK_MISSED; \
+            ip[-2] = OP_##name; \
+            ip -= 2; \
+            DISPATCH(); \
+        } \
+        if (site >= 0) quick_sites[site]->hits++; \
+        double lval = AS_NUMBER(left); \
+        double rval = AS_NUMBER(right); \
+        sp -= 2; \
+        /* ip is on the JUMP_IF_FALSE: opcode, target, condition kind */ \
+        ip = (expr) ? ip + 3 : frame->chunk->code + ip[1]; \
+        DISPATCH(); \
+    }
+
+    ARITH(ADD, lval + rval)
+    ARITH(SUB, lval - rval)
+    ARITH(MUL, lval * rval)
+    CASE(DIV) {
+        NUMBER_OPERANDS();
+        if (rval == 0) {
+            fprintf(stderr, "Division by zero\n");
+            exit(1);
+        }
+        sp--;
+        PEEK(0) = NUMBER_VAL(lval / rval);
+        DISPATCH();
+    }
+    COMPARE(EQ, lval == rval)
+    COMPARE(NEQ, lval != rval)
+    COMPARE(LT, lval < rval)
+    COMPARE(LE, lval <= rval)
+    COMPARE(GT, lval > rval)
+    COMPARE(GE, lval >= rval)
+
+    CASE(NEGATE) {
+        Value operand = PEEK(0);
+        if (!IS_NUMBER(operand)) {
+            fprintf(stderr, "Unary minus requires a number\n");
+            exit(1);
+        }
+        PEEK(0) = NUMBER_VAL(-AS_NUMBER(operand));
+        DISPATCH();
+    }
+    CASE(LIST) {
+        int count = READ();
+        SYNC();
+        Value list = create_list(sp - count, count);
+        sp -= count;
+        PUSH(list);
+        DISPATCH();
+    }
+    CASE(DICT) {
+        int count = READ();
+        for (int i = 0; i < count; i++) {
+            dict_check_key(sp[2 * (i - count)]);
+        }
+        // The pairs stay on the stack, where a collection can update them
+        SYNC();
+        Value dict = create_dict(count);
+        for (int i = 0; i < count; i++) {
+            dict_set(AS_OBJ(dict), sp[2 * (i - count)], sp[2 * (i - count) + 1]);
+        }
+        sp -= 2 * count;
+        PUSH(dict);
+        DISPATCH();
+    }
+    CASE(JUMP) {
+        int target = READ();
+        bool back_edge = target < ip - frame->chunk->code;
+        ip = frame->chunk->code + target;
+        if (back_edge) ENTER_JIT();
+        DISPATCH();
+    }
+    CASE(JUMP_IF_FALSE) {
+        int target = READ();
+        int what = READ();
+        Value cond = POP();
+        if (!IS_BOOL(cond)) {
+            fprintf(stderr, what == COND_LOOP ? "Loop condition must be boolean\n"
+                                              : "If condition must be boolean\n");
+            exit(1);
+        }
+        if (cond == FALSE_VAL) {
+            ip = frame->chunk->code + target;
+        }
+        DISPATCH();
+    }
+    CASE(RANGE_INIT) {
+        Value start_val = PEEK(1);
+        Value end_val = PEEK(0);
+        if (!IS_NUMBER(start_val) || !IS_NUMBER(end_val)) {
+            fprintf(stderr, "Range bounds must be numbers\n");
+            exit(1);
+        }
+        PEEK(1) = NUMBER_VAL((int)AS_NUMBER(start_val));
+        PEEK(0) = NUMBER_VAL((int)AS_NUMBER(end_val));
+        DISPATCH();
+    }
+    CASE(RANGE_NEXT) {
+        int scope = READ();
+        int slot = READ();
+        int exit_target = READ();
+        Value counter = PEEK(1);
+        if (AS_NUMBER(counter) > AS_NUMBER(PEEK(0))) {
+            ip = frame->chunk->code + exit_target;
+            DISPATCH();
+        }
+        if (scope == SCOPE_LOCAL) slots[slot] = counter; else globals[slot] = counter;
+        PEEK(1) = NUMBER_VAL(AS_NUMBER(counter) + 1);
+        DISPATCH();
+    }
+    CASE(LIST_INIT) {
+        if (!IS_LIST(PEEK(0)) && !IS_DICT(PEEK(0)) && !IS_RANGE(PEEK(0))) {
+            fprintf(stderr, "Each requires a list, dictionary or range\n");
+            exit(1);
+        }
+        PUSH(NUMBER_VAL(0));
+        DISPATCH();
+    }
+    CASE(LIST_NEXT) {
+        int scope = READ();
+        int slot = READ();
+        int exit_target = READ();
+        MASObject* list = AS_OBJ(PEEK(1));
+        int i = (int)AS_NUMBER(PEEK(0));
+        if (list->type == AST_RANGE) {
+            // Items are computed, never stored
+            if (i >= range_length(list)) {
+                ip = frame->chunk->code + exit_target;
+                DISPATCH();
+            }
+            Value item = NUMBER_VAL((double)list->data.range.start + (double)i * list->data.range.step);
+            if (scope == SCOPE_LOCAL) slots[slot] = item; else globals[slot] = item;
+            PEEK(0) = NUMBER_VAL(i + 1);
+            DISPATCH();
+        }
+        if (list->type == AST_DICT) {
+            // The counter is the next entry index; the loop binds keys
+            i = dict_next(list, i);
+            if (i < 0) {
+                ip = frame->chunk->code + exit_target;
+                DISPATCH();
+            }
+            Value key = list->data.dict.entries[i].key;
+            if (scope == SCOPE_LOCAL) slots[slot] = key; else globals[slot] = key;
+            PEEK(0) = NUMBER_VAL(i + 1);
+            DISPATCH();
+        }
+        if (i >= list->data.list.count) {
+            ip = frame->chunk->code + exit_target;
+            DISPATCH();
+        }
+        Value item = list->data.list.items[i];
+        if (scope == SCOPE_LOCAL) slots[slot] = item; else globals[slot] = item;
+        PEEK(0) = NUMBER_VAL(i + 1);
+        DISPATCH();
+    }
+    CASE(CALL)
+    CASE(TAIL_CALL) {
+        // Call sites name their callee with an atom (see name_constant).
+        // The first call binds the site to the function's index; a name
+        // keeps its first definition, so the binding never has to be undone.
+        Atom name = AS_STRING(constants[ip[0]]);
+        int index = atom_map_get(&vm->functions.names, name);
+        if (index < 0) {
+            fprintf(stderr, "Function not defined: %s\n", name);
+            exit(1);
+        }
+        FunctionProto* proto = vm->functions.protos[index];
+        if (ip[1] != proto->param_count) {
+            fprintf(stderr, "Function %s expects %d arguments, got %d\n",
+                    proto->name, proto->param_count, ip[1]);
+            exit(1);
+        }
+        ip[-1] = ip[-1] == OP_CALL ? OP_CALL_FUNCTION : OP_TAIL_CALL_FUNCTION;
+        ip[0] = index;
+        ip--;
+        DISPATCH();
+    }
+    CASE(CALL_FUNCTION) {
+        // Bound sites were checked when CALL rewrote them
+        FunctionProto* proto = vm->functions.protos[READ()];
+        int argc = READ();
+
+        // The arguments already on the stack become the callee's first locals
+        frame->ip = ip;
+        SYNC();
+        vm_push_frame(vm, proto, &proto->chunk, argc);
+        LOAD_FRAME();
+        sp = vm->stack + vm->stack_top;
+        ENTER_JIT();
+        DISPATCH();
+    }
+    CASE(TAIL_CALL_FUNCTION) {
+        FunctionProto* proto = vm->functions.protos[READ()];
+        int argc = READ();
+
+        // The arguments replace the caller's locals and the frame is reused
+        memmove(slots, sp - argc, sizeof(Value) * argc);
+        sp = slots + argc;
+        SYNC();
+        vm_enter_frame(vm, frame, proto, &proto->chunk, argc);
+        LOAD_FRAME();
+        sp = vm->stack + vm->stack_top;
+        ENTER_JIT();
+        DISPATCH();
+    }
+    CASE(CALL_BUILTIN) {
+        BuiltinFn fn = builtins[READ()].fn;
+        int argc = READ();
+        // Arguments stay on the stack during the call so the GC can see them
+        SYNC();
+        Value result = fn(&vm->interp, sp - argc, argc);
+        sp -= argc;
+        PUSH(result);
+        RESUME_JIT();
+        DISPATCH();
+    }
+    CASE(DEF) {
+        vm_define_function(vm, frame->chunk->functions[READ()]);
+        DISPATCH();
+    }
+    CASE(RETURN) {
+        Value result = POP();
+        vm->frame_count--;
+        sp = vm->stack + frame->base;
+        LOAD_FRAME();
+        PUSH(result);
+        RESUME_JIT();
+        DISPATCH();
+    }
+    CASE(HALT) {
+        SYNC();
+        return NULL_VAL;
+    }
+
+#if !defined(__GNUC__)
+        default:
+            fprintf(stderr, "Unknown opcode: %d\n", ip[-1]);
+            exit(1);
+        }
+    }
+#endif
+
+#undef READ
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef LINE
+#undef SYNC
+#undef LOAD_FRAME
+#undef RUN_JIT
+#undef ENTER_JIT
+#undef RESUME_JIT
+#undef DISPATCH
+#undef CASE
+#undef NUMBER_OPERANDS
+#undef ARITH
+#undef COMPARE
+}
+
+// The parts of a program (one per top-level statement with --stream) run
+// one after another on this VM, sharing globals and functions
+static VM session;
+
+void vm_begin(void) {
+    session = (VM){0};
+    session.interp.vm = &session;
+    gc_set_interpreter(&session.interp);
+}
+
+Value vm_next(ASTNode* program) {
+    Chunk* chunk = compile_program(program);
+    interpreter_reserve_globals(&session.interp);
+
+    session.stack_top = 0;
+    session.frame_count = 0;
+    vm_push_frame(&session, NULL, chunk, 0);
+    Value result = vm_run(&session);
+    free_chunk(chunk);
+    return result;
+}
+
+void vm_end(void) {
+    gc_set_interpreter(NULL);
+    free(session.interp.globals);
+    free(session.stack);
+    free(session.frames);
+    atom_map_free(&session.functions.names);
+    free(session.functions.protos);
+}
+
+Value vm_interpret(ASTNode* ast) {
+    vm_begin();
+    Value result = vm_next(ast);
+    vm_end();
+    return result;
+}